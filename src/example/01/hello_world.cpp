@@ -24,7 +24,7 @@ int main(int argc, char **argv)
   scppr::scppr *renderer = new scppr::scppr("Hello world", directory);
   scppr::model_t *cube = new scppr::model_t(directory + "cube.obj");
   scppr::object_t *obj = new scppr::object_t();
-  obj -> model = cube;
+  obj -> set_model(cube);
   renderer -> add_object(obj);
   renderer -> add_listener(scppr::scroll_listener, (void *)&process_mouse_scroll);
   while(renderer -> is_open())
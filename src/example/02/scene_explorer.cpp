@@ -97,22 +97,22 @@ int main(int argc, char **argv)
   scppr::scppr renderer("Scene explorer", directory);
   scppr::model_t* cube = new scppr::model_t(directory + "cube.obj");
   scppr::material_t mat;
-  mat.diffuse = new scppr::texture_t(directory + "container2.png");
-  mat.specular = new scppr::texture_t(directory + "container2_specular.png");
+  mat.diffuse = scppr::load_texture(directory + "container2.png");
+  mat.specular = scppr::load_texture(directory + "container2_specular.png");
   scppr::object_t *cube1 = new scppr::object_t();
-                   cube1 -> model = cube;
+                   cube1 -> set_model(cube);
                    cube1 -> material_overwrite[0] = mat;
   scppr::material_t mat2 = mat;
   mat2.diffuse = NULL;
   scppr::object_t *cube2 = new scppr::object_t();
-                   cube2 -> model = cube;
-                   cube2 -> position.x = -5;
+                   cube2 -> set_model(cube);
+                   cube2 -> set_position({-5, 0, 0});
                    cube2 -> material_overwrite[0] = mat2;
   mat2 = mat;
   mat2.specular = NULL;
   scppr::object_t *cube3 = new scppr::object_t();
-                   cube3 -> model = cube;
-                   cube3 -> position.x = 5;
+                   cube3 -> set_model(cube);
+                   cube3 -> set_position({5, 0, 0});
                    cube3 -> material_overwrite[0] = mat2;
   scppr::light_t *light1 = new scppr::light_t();
                   light1 -> position = {0, 10, -5};
@@ -120,10 +120,10 @@ int main(int argc, char **argv)
   scppr::light_t *light2 = new scppr::light_t();
                   light2 -> position = {0, -10, 5};
   scppr::material_t mat3;
-  mat3.diffuse = new scppr::texture_t(directory + "thonk.png");
+  mat3.diffuse = scppr::load_texture(directory + "thonk.png");
   scppr::object_t *cube4 = new scppr::object_t();
-                   cube4 -> model = cube;
-                   cube4 -> position.y = 5;
+                   cube4 -> set_model(cube);
+                   cube4 -> set_position({0, 5, 0});
                    cube4 -> material_overwrite[0] = mat3;
   renderer.add_object(cube1);
   renderer.add_object(cube2);
@@ -151,9 +151,9 @@ int main(int argc, char **argv)
   delete cube3;
   delete light1;
   delete light2;
-  delete mat.diffuse;
-  delete mat.specular;
-  delete mat3.diffuse;
+  scppr::release_texture(mat.diffuse);
+  scppr::release_texture(mat.specular);
+  scppr::release_texture(mat3.diffuse);
   delete cube;
   return 0;
 }
@@ -0,0 +1,93 @@
+#include "scppr.h"
+#include "lib/transform/transform.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// compares the batch transform kernels against the glm chain draw used to run, no window needed
+
+const size_t object_count = 100000;
+const int rounds = 20;
+
+// the per object path the kernels replace
+void glm_transforms(const std::vector<uint32_t> &indices, const std::vector<glm::dvec3> &positions, const std::vector<glm::dvec3> &rotations, const std::vector<glm::dvec3> &scales, std::vector<instance_t> &transforms)
+{
+  for(uint32_t i : indices)
+  {
+    glm::dmat4 model = glm::dmat4(1);
+               model = glm::translate(model, positions[i]);
+               model = glm::rotate(model, rotations[i].x, {1, 0, 0});
+               model = glm::rotate(model, rotations[i].y, {0, 1, 0});
+               model = glm::rotate(model, rotations[i].z, {0, 0, 1});
+               model = glm::scale(model, scales[i]);
+    transforms[i].model = model;
+    transforms[i].normal = glm::mat3(glm::transpose(glm::inverse(glm::dmat3(model))));
+  }
+}
+
+double max_error(const std::vector<instance_t> &a, const std::vector<instance_t> &b)
+{
+  double error = 0;
+  for(size_t i = 0; i < a.size(); i++)
+  {
+    const float *fa = &a[i].model[0][0];
+    const float *fb = &b[i].model[0][0];
+    for(int j = 0; j < 16; j++)
+    {
+      error = std::max(error, (double)std::fabs(fa[j] - fb[j]) / (1 + std::fabs(fb[j])));
+    }
+    fa = &a[i].normal[0][0];
+    fb = &b[i].normal[0][0];
+    for(int j = 0; j < 9; j++)
+    {
+      error = std::max(error, (double)std::fabs(fa[j] - fb[j]) / (1 + std::fabs(fb[j])));
+    }
+  }
+  return error;
+}
+
+template<typename F> double time_per_object(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < rounds; i++)
+  {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / (rounds * object_count);
+}
+
+int main(int argc, char **argv)
+{
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<double> unit(-1, 1);
+  std::vector<glm::dvec3> positions(object_count);
+  std::vector<glm::dvec3> rotations(object_count);
+  std::vector<glm::dvec3> scales(object_count);
+  std::vector<uint32_t> indices(object_count);
+  for(size_t i = 0; i < object_count; i++)
+  {
+    positions[i] = {unit(generator) * 100, unit(generator) * 100, unit(generator) * 100};
+    rotations[i] = {unit(generator) * M_PI * 4, unit(generator) * M_PI * 4, unit(generator) * M_PI * 4};
+    scales[i] = {1.5 + unit(generator), 1.5 + unit(generator), 1.5 + unit(generator)};
+    indices[i] = i;
+  }
+
+  std::vector<instance_t> reference(object_count);
+  std::vector<instance_t> scalar(object_count);
+  std::vector<instance_t> batch(object_count);
+  double glm_ns = time_per_object([&](){ glm_transforms(indices, positions, rotations, scales, reference); });
+  double scalar_ns = time_per_object([&](){ scppr::compute_transforms_scalar(indices.data(), object_count, positions.data(), rotations.data(), scales.data(), scalar.data()); });
+  double batch_ns = time_per_object([&](){ scppr::compute_transforms(indices.data(), object_count, positions.data(), rotations.data(), scales.data(), batch.data()); });
+  double scalar_error = max_error(scalar, reference);
+  double batch_error = max_error(batch, reference);
+
+  printf("%zu objects, %d rounds\n", object_count, rounds);
+  printf("glm            %8.2f ns/object\n", glm_ns);
+  printf("scalar         %8.2f ns/object, max relative error %g\n", scalar_ns, scalar_error);
+  printf("batch (%-6s) %8.2f ns/object, max relative error %g\n", scppr::transform_kernel(), batch_ns, batch_error);
+  return scalar_error < 1e-4 && batch_error < 1e-4 ? 0 : 1;
+}
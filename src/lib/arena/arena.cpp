@@ -0,0 +1,112 @@
+#include "lib/arena/arena.h"
+#include "lib/gl/gl.h"
+#include "lib/log.h"
+#include <iterator>
+#include <string>
+
+// the copy targets are used throughout so nothing bound for drawing is disturbed, element buffers in particular
+
+scppr::arena_t::arena_t(size_t element_size, size_t capacity)
+{
+  this -> element_size = element_size;
+  this -> capacity = capacity;
+  glGenBuffers(1, &buffer);
+  gl_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, capacity * element_size, NULL, GL_STATIC_DRAW);
+}
+
+scppr::arena_t::~arena_t()
+{
+  gl_delete_buffer(buffer);
+}
+
+size_t scppr::arena_t::allocate(size_t count)
+{
+  for(auto it = free_ranges.begin(); it != free_ranges.end(); it++)
+  {
+    if(it -> second < count)
+    {
+      continue;
+    }
+    size_t first = it -> first;
+    size_t left = it -> second - count;
+    free_ranges.erase(it);
+    if(left)
+    {
+      free_ranges[first + count] = left;
+    }
+    freed -= count;
+    return first;
+  }
+  if(top + count > capacity)
+  {
+    grow(top + count);
+  }
+  size_t first = top;
+  top += count;
+  return first;
+}
+
+void scppr::arena_t::free(size_t first, size_t count)
+{
+  if(!count)
+  {
+    return;
+  }
+  freed += count;
+  auto next = free_ranges.lower_bound(first);
+  if(next != free_ranges.begin())
+  {
+    auto previous = std::prev(next);
+    if(previous -> first + previous -> second == first)
+    {
+      first = previous -> first;
+      count += previous -> second;
+      free_ranges.erase(previous);
+    }
+  }
+  if(next != free_ranges.end() && first + count == next -> first)
+  {
+    count += next -> second;
+    free_ranges.erase(next);
+  }
+  // a range ending at the top gives the space back to the bump allocator
+  if(first + count == top)
+  {
+    top = first;
+    freed -= count;
+    return;
+  }
+  free_ranges[first] = count;
+}
+
+void scppr::arena_t::upload(size_t first, size_t count, const void *data)
+{
+  gl_bind_buffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, first * element_size, count * element_size, data);
+}
+
+size_t scppr::arena_t::used()
+{
+  return top - freed;
+}
+
+void scppr::arena_t::grow(size_t minimum)
+{
+  size_t grown = capacity ? capacity * 2 : 1;
+  while(grown < minimum)
+  {
+    grown *= 2;
+  }
+  scppr_DEBUG("growing arena from " + std::to_string(capacity * element_size) + " to " + std::to_string(grown * element_size) + " bytes");
+  GLuint grown_buffer;
+  glGenBuffers(1, &grown_buffer);
+  gl_bind_buffer(GL_COPY_WRITE_BUFFER, grown_buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, grown * element_size, NULL, GL_STATIC_DRAW);
+  gl_bind_buffer(GL_COPY_READ_BUFFER, buffer);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, top * element_size);
+  gl_delete_buffer(buffer);
+  buffer = grown_buffer;
+  capacity = grown;
+  generation++;
+}
@@ -0,0 +1,36 @@
+#ifndef SCPPR_LIB_ARENA_ARENA_H
+#define SCPPR_LIB_ARENA_ARENA_H
+
+#include "lib/glad.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace scppr
+{
+  // one gl buffer handed out in ranges of fixed size elements
+  // freed ranges are merged with their neighbours and reused first fit, the buffer doubles when nothing fits
+  class arena_t
+  {
+  public:
+    arena_t(size_t element_size, size_t capacity);
+    ~arena_t();
+    // first element of a new range of count elements
+    size_t allocate(size_t count);
+    void free(size_t first, size_t count);
+    void upload(size_t first, size_t count, const void *data);
+    size_t used();
+    GLuint buffer;
+    size_t capacity;
+    // bumped whenever growing replaced buffer, anything pointing at the old one has to be set up again
+    uint64_t generation = 0;
+  private:
+    void grow(size_t minimum);
+    size_t element_size;
+    size_t top = 0;
+    size_t freed = 0;
+    std::map<size_t, size_t> free_ranges;
+  };
+}
+
+#endif // SCPPR_LIB_ARENA_ARENA_H
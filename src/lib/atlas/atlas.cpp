@@ -0,0 +1,253 @@
+#include "lib/atlas/atlas.h"
+#include "lib/gl/gl.h"
+#include "lib/log.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace
+{
+  std::atomic<uint32_t> next_array_key(0);
+  const int initial_layers = 4;
+
+  int level_count(int width, int height)
+  {
+    int levels = 1;
+    while((width >> levels) || (height >> levels))
+    {
+      levels++;
+    }
+    return levels;
+  }
+
+  // copies the image with its border pixels repeated padding times on every side
+  std::vector<unsigned char> pad_image(int width, int height, const unsigned char *rgba, int padding)
+  {
+    int padded_width = width + 2 * padding;
+    int padded_height = height + 2 * padding;
+    std::vector<unsigned char> padded(padded_width * padded_height * 4);
+    for(int y = 0; y < padded_height; y++)
+    {
+      int source_y = std::min(std::max(y - padding, 0), height - 1);
+      for(int x = 0; x < padded_width; x++)
+      {
+        int source_x = std::min(std::max(x - padding, 0), width - 1);
+        std::copy_n(rgba + (source_y * width + source_x) * 4, 4, padded.data() + (y * padded_width + x) * 4);
+      }
+    }
+    return padded;
+  }
+}
+
+scppr::texture_array_t::texture_array_t(int width, int height, bool packed)
+{
+  this -> width = width;
+  this -> height = height;
+  this -> packed = packed;
+  key_id = next_array_key++;
+  levels = packed ? SCPPR_ATLAS_MAX_LEVEL + 1 : level_count(width, height);
+  capacity = initial_layers;
+  scppr_DEBUG("creating " + std::string(packed ? "packed " : "") + "texture array of " + std::to_string(width) + "x" + std::to_string(height));
+  id = create(capacity);
+}
+
+scppr::texture_array_t::~texture_array_t()
+{
+  gl_delete_texture(id);
+}
+
+bool scppr::texture_array_t::place(int width, int height, const unsigned char *rgba, texture_slot_t &slot)
+{
+  if(!packed && (width != this -> width || height != this -> height))
+  {
+    return false;
+  }
+  int padding = packed ? SCPPR_ATLAS_PADDING : 0;
+  int padded_width = width + 2 * padding;
+  int padded_height = height + 2 * padding;
+  if(padded_width > this -> width || padded_height > this -> height)
+  {
+    return false;
+  }
+
+  uint32_t layer;
+  int x, y;
+  while(!find(padded_width, padded_height, layer, x, y))
+  {
+    GLint max_layers;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+    if(capacity * 2 > max_layers)
+    {
+      return false;
+    }
+    grow();
+  }
+
+  gl_bind_texture(GL_TEXTURE_2D_ARRAY, id);
+  if(padding)
+  {
+    std::vector<unsigned char> padded = pad_image(width, height, rgba, padding);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, padded_width, padded_height, 1, GL_RGBA, GL_UNSIGNED_BYTE, padded.data());
+  }
+  else
+  {
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+  }
+  layers[layer].images++;
+  dirty = true;
+
+  slot.array = this;
+  slot.layer = layer;
+  slot.rect = glm::vec4((float)(x + padding) / this -> width, (float)(y + padding) / this -> height, (float)width / this -> width, (float)height / this -> height);
+  return true;
+}
+
+void scppr::texture_array_t::release(const texture_slot_t &slot)
+{
+  layer_t &layer = layers[slot.layer];
+  layer.images--;
+  if(!layer.images)
+  {
+    layer.shelves.clear();
+    layer.top = 0;
+  }
+}
+
+void scppr::texture_array_t::flush()
+{
+  if(!dirty)
+  {
+    return;
+  }
+  gl_bind_texture(GL_TEXTURE_2D_ARRAY, id);
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+  dirty = false;
+}
+
+GLuint scppr::texture_array_t::create(int layers)
+{
+  GLuint array;
+  glGenTextures(1, &array);
+  gl_bind_texture(GL_TEXTURE_2D_ARRAY, array);
+  for(int level = 0; level < levels; level++)
+  {
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(width >> level, 1), std::max(height >> level, 1), layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  }
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // packed images wrap in the shader, sampling past the layer edge would pick up a neighbour
+  GLint wrap = packed ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+  return array;
+}
+
+bool scppr::texture_array_t::find(int width, int height, uint32_t &layer, int &x, int &y)
+{
+  for(layer = 0; layer < layers.size(); layer++)
+  {
+    layer_t &current = layers[layer];
+    if(!packed)
+    {
+      if(!current.images)
+      {
+        x = 0;
+        y = 0;
+        return true;
+      }
+      continue;
+    }
+    // first shelf tall enough with room left, shelves much taller than the image are skipped to limit waste
+    for(auto &shelf : current.shelves)
+    {
+      if(shelf.height >= height && shelf.height <= height * 2 && shelf.x + width <= this -> width)
+      {
+        x = shelf.x;
+        y = shelf.y;
+        shelf.x += width;
+        return true;
+      }
+    }
+    if(current.top + height <= this -> height)
+    {
+      shelf_t shelf;
+      shelf.y = current.top;
+      shelf.height = height;
+      shelf.x = width;
+      current.shelves.push_back(shelf);
+      current.top += height;
+      x = 0;
+      y = shelf.y;
+      return true;
+    }
+  }
+  if(layers.size() < (size_t)capacity)
+  {
+    layers.push_back(layer_t());
+    return find(width, height, layer, x, y);
+  }
+  return false;
+}
+
+void scppr::texture_array_t::grow()
+{
+  int grown = capacity * 2;
+  scppr_DEBUG("growing texture array to " + std::to_string(grown) + " layers");
+  // the new array stays bound as the copy destination
+  GLuint grown_id = create(grown);
+
+  // gl 4.0 has no image copies, every layer and level goes through a read framebuffer instead
+  GLint previous;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+  GLuint framebuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  for(uint32_t layer = 0; layer < layers.size(); layer++)
+  {
+    for(int level = 0; level < levels; level++)
+    {
+      glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, id, level, layer);
+      glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, 0, 0, std::max(width >> level, 1), std::max(height >> level, 1));
+    }
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+  glDeleteFramebuffers(1, &framebuffer);
+
+  gl_delete_texture(id);
+  id = grown_id;
+  capacity = grown;
+}
+
+scppr::atlas_t::~atlas_t()
+{
+  for(auto array : arrays)
+  {
+    delete array;
+  }
+}
+
+scppr::texture_slot_t scppr::atlas_t::add(int width, int height, const unsigned char *rgba)
+{
+  texture_slot_t slot;
+  bool small = width <= SCPPR_ATLAS_MAX_TILE && height <= SCPPR_ATLAS_MAX_TILE;
+  for(auto array : arrays)
+  {
+    if(array -> packed == small && array -> place(width, height, rgba, slot))
+    {
+      return slot;
+    }
+  }
+  texture_array_t *array = small ? new texture_array_t(SCPPR_ATLAS_SIZE, SCPPR_ATLAS_SIZE, true) : new texture_array_t(width, height, false);
+  arrays.push_back(array);
+  scppr_ASSERT(array -> place(width, height, rgba, slot), "texture does not fit an empty texture array");
+  return slot;
+}
+
+void scppr::atlas_t::flush()
+{
+  for(auto array : arrays)
+  {
+    array -> flush();
+  }
+}
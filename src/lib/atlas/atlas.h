@@ -0,0 +1,85 @@
+#ifndef SCPPR_LIB_ATLAS_ATLAS_H
+#define SCPPR_LIB_ATLAS_ATLAS_H
+
+#include "lib/glad.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace scppr
+{
+  // layer size of the packed arrays
+  static const int SCPPR_ATLAS_SIZE = 2048;
+  // images up to this size in both directions are packed, larger ones get a layer of their own
+  static const int SCPPR_ATLAS_MAX_TILE = 512;
+  // pixels repeated around every packed image, enough for the mip levels packed arrays keep
+  static const int SCPPR_ATLAS_PADDING = 8;
+  static const int SCPPR_ATLAS_MAX_LEVEL = 3;
+
+  class texture_array_t;
+
+  // where an image ended up, the array name can change when it grows so it is looked up through array
+  struct texture_slot_t
+  {
+    texture_array_t *array = NULL;
+    uint32_t layer = 0;
+    // offset and size of the image in the layer, in texture coordinates
+    glm::vec4 rect = {0, 0, 1, 1};
+  };
+
+  // one GL_TEXTURE_2D_ARRAY, every layer holds one image or, when packed, shelves of smaller ones
+  // layers double when the array is full, the old contents are copied over on the gpu
+  class texture_array_t
+  {
+  public:
+    texture_array_t(int width, int height, bool packed);
+    ~texture_array_t();
+    // false when the array cannot take the image
+    bool place(int width, int height, const unsigned char *rgba, texture_slot_t &slot);
+    // layers are reused once everything on them was released, textures release their own slots
+    void release(const texture_slot_t &slot);
+    // rebuilds mipmaps when something was placed since the last call
+    void flush();
+    GLuint id;
+    // small dense number used in draw sort keys
+    uint32_t key_id;
+    int width;
+    int height;
+    bool packed;
+  private:
+    struct shelf_t
+    {
+      int y;
+      int height;
+      int x;
+    };
+    struct layer_t
+    {
+      std::vector<shelf_t> shelves;
+      int top = 0;
+      uint32_t images = 0;
+    };
+    // allocates every level for the given number of layers and leaves the array bound
+    GLuint create(int layers);
+    bool find(int width, int height, uint32_t &layer, int &x, int &y);
+    void grow();
+    int levels;
+    int capacity;
+    std::vector<layer_t> layers;
+    bool dirty = false;
+  };
+
+  // routes images into texture arrays, packing small ones and grouping large ones by size
+  class atlas_t
+  {
+  public:
+    ~atlas_t();
+    texture_slot_t add(int width, int height, const unsigned char *rgba);
+    // called before drawing
+    void flush();
+  private:
+    std::vector<texture_array_t *> arrays;
+  };
+}
+
+#endif // SCPPR_LIB_ATLAS_ATLAS_H
@@ -0,0 +1,532 @@
+#include "lib/bvh/bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// primitives per leaf
+static const uint32_t SCPPR_BVH_LEAF_SIZE = 4;
+
+namespace
+{
+  scppr::box_t merge(const scppr::box_t &a, const scppr::box_t &b)
+  {
+    scppr::box_t box;
+    box.min = glm::min(a.min, b.min);
+    box.max = glm::max(a.max, b.max);
+    return box;
+  }
+
+  float area(const scppr::box_t &box)
+  {
+    glm::vec3 size = box.max - box.min;
+    return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+
+  // -1 outside, 0 intersecting, 1 inside
+  int classify(const scppr::frustum_t &frustum, const scppr::box_t &box)
+  {
+    int result = 1;
+    for(int i = 0; i < 6; i++)
+    {
+      const glm::vec4 &plane = frustum.planes[i];
+      glm::vec3 far_corner = glm::vec3(plane.x >= 0 ? box.max.x : box.min.x, plane.y >= 0 ? box.max.y : box.min.y, plane.z >= 0 ? box.max.z : box.min.z);
+      glm::vec3 near_corner = glm::vec3(plane.x >= 0 ? box.min.x : box.max.x, plane.y >= 0 ? box.min.y : box.max.y, plane.z >= 0 ? box.min.z : box.max.z);
+      if(glm::dot(glm::vec3(plane), far_corner) + plane.w < 0)
+      {
+        return -1;
+      }
+      if(glm::dot(glm::vec3(plane), near_corner) + plane.w < 0)
+      {
+        result = 0;
+      }
+    }
+    return result;
+  }
+
+  // entry distance of the ray into the box, negative when it is missed
+  float ray_box(glm::vec3 origin, glm::vec3 inverse_direction, const scppr::box_t &box)
+  {
+    float t_min = 0;
+    float t_max = std::numeric_limits<float>::infinity();
+    for(int axis = 0; axis < 3; axis++)
+    {
+      float t0 = (box.min[axis] - origin[axis]) * inverse_direction[axis];
+      float t1 = (box.max[axis] - origin[axis]) * inverse_direction[axis];
+      if(t0 > t1)
+      {
+        std::swap(t0, t1);
+      }
+      t_min = std::max(t_min, t0);
+      t_max = std::min(t_max, t1);
+      if(t_min > t_max)
+      {
+        return -1;
+      }
+    }
+    return t_min;
+  }
+}
+
+void scppr::bvh_t::build(const std::vector<uint32_t> &ids, const std::vector<box_t> &boxes)
+{
+  prim_ids = ids;
+  prim_boxes = boxes;
+  free_prims.clear();
+  id_to_prim.clear();
+  for(uint32_t i = 0; i < prim_ids.size(); i++)
+  {
+    id_to_prim[prim_ids[i]] = i;
+  }
+  rebuild();
+}
+
+void scppr::bvh_t::rebuild()
+{
+  // holes left by removals are squeezed out first
+  if(!free_prims.empty())
+  {
+    std::vector<uint32_t> ids;
+    std::vector<box_t> boxes;
+    ids.reserve(id_to_prim.size());
+    boxes.reserve(id_to_prim.size());
+    for(uint32_t i = 0; i < prim_ids.size(); i++)
+    {
+      auto it = id_to_prim.find(prim_ids[i]);
+      if(it != id_to_prim.end() && it -> second == i)
+      {
+        ids.push_back(prim_ids[i]);
+        boxes.push_back(prim_boxes[i]);
+      }
+    }
+    prim_ids.swap(ids);
+    prim_boxes.swap(boxes);
+    free_prims.clear();
+  }
+  nodes.clear();
+  free_nodes.clear();
+  root = UINT32_MAX;
+  changed = 0;
+  prim_leaf.assign(prim_ids.size(), 0);
+  if(prim_ids.empty())
+  {
+    built_area = 0;
+    return;
+  }
+  nodes.reserve(2 * prim_ids.size() / SCPPR_BVH_LEAF_SIZE + 1);
+  root = build_node(0, prim_ids.size(), UINT32_MAX);
+  for(uint32_t i = 0; i < prim_ids.size(); i++)
+  {
+    id_to_prim[prim_ids[i]] = i;
+  }
+  built_area = area(nodes[root].box);
+}
+
+uint32_t scppr::bvh_t::build_node(uint32_t begin, uint32_t end, uint32_t parent)
+{
+  uint32_t index = nodes.size();
+  nodes.push_back(node_t());
+  node_t node;
+  node.parent = parent;
+  node.left = UINT32_MAX;
+  node.right = UINT32_MAX;
+  node.box = prim_boxes[begin];
+  glm::vec3 centroid_min = (prim_boxes[begin].min + prim_boxes[begin].max) * 0.5f;
+  glm::vec3 centroid_max = centroid_min;
+  for(uint32_t i = begin; i < end; i++)
+  {
+    node.box = merge(node.box, prim_boxes[i]);
+    glm::vec3 centroid = (prim_boxes[i].min + prim_boxes[i].max) * 0.5f;
+    centroid_min = glm::min(centroid_min, centroid);
+    centroid_max = glm::max(centroid_max, centroid);
+  }
+
+  if(end - begin <= SCPPR_BVH_LEAF_SIZE)
+  {
+    node.first = begin;
+    node.count = end - begin;
+    for(uint32_t i = begin; i < end; i++)
+    {
+      prim_leaf[i] = index;
+    }
+    nodes[index] = node;
+    return index;
+  }
+
+  // split at the median centroid along the widest axis
+  glm::vec3 spread = centroid_max - centroid_min;
+  int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+  uint32_t middle = begin + (end - begin) / 2;
+  std::vector<uint32_t> order(end - begin);
+  for(uint32_t i = 0; i < order.size(); i++)
+  {
+    order[i] = begin + i;
+  }
+  std::nth_element(order.begin(), order.begin() + (middle - begin), order.end(), [this, axis](uint32_t a, uint32_t b)
+  {
+    return prim_boxes[a].min[axis] + prim_boxes[a].max[axis] < prim_boxes[b].min[axis] + prim_boxes[b].max[axis];
+  });
+  std::vector<uint32_t> ids(order.size());
+  std::vector<box_t> boxes(order.size());
+  for(uint32_t i = 0; i < order.size(); i++)
+  {
+    ids[i] = prim_ids[order[i]];
+    boxes[i] = prim_boxes[order[i]];
+  }
+  std::copy(ids.begin(), ids.end(), prim_ids.begin() + begin);
+  std::copy(boxes.begin(), boxes.end(), prim_boxes.begin() + begin);
+
+  node.first = 0;
+  node.count = 0;
+  nodes[index] = node;
+  uint32_t left = build_node(begin, middle, index);
+  uint32_t right = build_node(middle, end, index);
+  nodes[index].left = left;
+  nodes[index].right = right;
+  return index;
+}
+
+uint32_t scppr::bvh_t::allocate_node()
+{
+  if(free_nodes.empty())
+  {
+    nodes.push_back(node_t());
+    return nodes.size() - 1;
+  }
+  uint32_t index = free_nodes.back();
+  free_nodes.pop_back();
+  return index;
+}
+
+void scppr::bvh_t::clear()
+{
+  nodes.clear();
+  free_nodes.clear();
+  root = UINT32_MAX;
+  prim_ids.clear();
+  prim_boxes.clear();
+  prim_leaf.clear();
+  free_prims.clear();
+  id_to_prim.clear();
+  built_area = 0;
+  changed = 0;
+}
+
+bool scppr::bvh_t::contains(uint32_t id)
+{
+  return id_to_prim.count(id);
+}
+
+size_t scppr::bvh_t::size()
+{
+  return id_to_prim.size();
+}
+
+void scppr::bvh_t::insert(uint32_t id, const box_t &box)
+{
+  if(contains(id))
+  {
+    refit(id, box);
+    return;
+  }
+  changed++;
+  uint32_t prim;
+  if(free_prims.empty())
+  {
+    prim = prim_ids.size();
+    prim_ids.push_back(id);
+    prim_boxes.push_back(box);
+    prim_leaf.push_back(0);
+  }
+  else
+  {
+    prim = free_prims.back();
+    free_prims.pop_back();
+    prim_ids[prim] = id;
+    prim_boxes[prim] = box;
+  }
+  id_to_prim[id] = prim;
+
+  uint32_t leaf = allocate_node();
+  nodes[leaf].box = box;
+  nodes[leaf].left = UINT32_MAX;
+  nodes[leaf].right = UINT32_MAX;
+  nodes[leaf].first = prim;
+  nodes[leaf].count = 1;
+  prim_leaf[prim] = leaf;
+  if(root == UINT32_MAX)
+  {
+    nodes[leaf].parent = UINT32_MAX;
+    root = leaf;
+    built_area = area(box);
+    return;
+  }
+
+  // walks down while pairing with a child costs less area than pairing here, as in box2d's dynamic tree
+  uint32_t sibling = root;
+  while(!nodes[sibling].count)
+  {
+    const node_t &node = nodes[sibling];
+    float here = area(merge(node.box, box));
+    // every node below grows by at least this much
+    float inherited = here - area(node.box);
+    float costs[2];
+    uint32_t children[2] = {node.left, node.right};
+    for(int i = 0; i < 2; i++)
+    {
+      const node_t &child = nodes[children[i]];
+      float grown = area(merge(child.box, box));
+      costs[i] = (child.count ? grown : grown - area(child.box)) + inherited;
+    }
+    if(here <= costs[0] && here <= costs[1])
+    {
+      break;
+    }
+    sibling = costs[0] <= costs[1] ? children[0] : children[1];
+  }
+
+  uint32_t parent = allocate_node();
+  uint32_t grandparent = nodes[sibling].parent;
+  nodes[parent].parent = grandparent;
+  nodes[parent].left = sibling;
+  nodes[parent].right = leaf;
+  nodes[parent].first = 0;
+  nodes[parent].count = 0;
+  nodes[sibling].parent = parent;
+  nodes[leaf].parent = parent;
+  if(grandparent == UINT32_MAX)
+  {
+    root = parent;
+  }
+  else if(nodes[grandparent].left == sibling)
+  {
+    nodes[grandparent].left = parent;
+  }
+  else
+  {
+    nodes[grandparent].right = parent;
+  }
+  refit_from(parent);
+}
+
+void scppr::bvh_t::remove(uint32_t id)
+{
+  auto it = id_to_prim.find(id);
+  if(it == id_to_prim.end())
+  {
+    return;
+  }
+  changed++;
+  uint32_t prim = it -> second;
+  id_to_prim.erase(it);
+  uint32_t leaf = prim_leaf[prim];
+  node_t &node = nodes[leaf];
+  // the last primitive of the leaf fills the hole, so the leaf stays a range
+  uint32_t last = node.first + node.count - 1;
+  if(prim != last)
+  {
+    prim_ids[prim] = prim_ids[last];
+    prim_boxes[prim] = prim_boxes[last];
+    id_to_prim[prim_ids[prim]] = prim;
+  }
+  free_prims.push_back(last);
+  node.count--;
+  if(node.count)
+  {
+    refit_from(leaf);
+    return;
+  }
+
+  // an empty leaf goes, its sibling takes the place of their parent
+  uint32_t parent = node.parent;
+  free_nodes.push_back(leaf);
+  if(parent == UINT32_MAX)
+  {
+    root = UINT32_MAX;
+    return;
+  }
+  uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+  uint32_t grandparent = nodes[parent].parent;
+  nodes[sibling].parent = grandparent;
+  free_nodes.push_back(parent);
+  if(grandparent == UINT32_MAX)
+  {
+    root = sibling;
+    return;
+  }
+  if(nodes[grandparent].left == parent)
+  {
+    nodes[grandparent].left = sibling;
+  }
+  else
+  {
+    nodes[grandparent].right = sibling;
+  }
+  refit_from(grandparent);
+}
+
+void scppr::bvh_t::refit(uint32_t id, const box_t &box)
+{
+  auto it = id_to_prim.find(id);
+  if(it == id_to_prim.end())
+  {
+    return;
+  }
+  prim_boxes[it -> second] = box;
+  refit_from(prim_leaf[it -> second]);
+}
+
+void scppr::bvh_t::refit_from(uint32_t index)
+{
+  while(index != UINT32_MAX)
+  {
+    node_t &node = nodes[index];
+    if(node.count)
+    {
+      node.box = prim_boxes[node.first];
+      for(uint32_t i = node.first + 1; i < node.first + node.count; i++)
+      {
+        node.box = merge(node.box, prim_boxes[i]);
+      }
+    }
+    else
+    {
+      node.box = merge(nodes[node.left].box, nodes[node.right].box);
+    }
+    index = node.parent;
+  }
+}
+
+float scppr::bvh_t::growth()
+{
+  if(root == UINT32_MAX || built_area <= 0)
+  {
+    return 1;
+  }
+  return area(nodes[root].box) / built_area;
+}
+
+size_t scppr::bvh_t::changes()
+{
+  return changed;
+}
+
+void scppr::bvh_t::collect(uint32_t node, std::vector<uint32_t> &ids)
+{
+  size_t bottom = stack.size();
+  stack.push_back(node);
+  while(stack.size() > bottom)
+  {
+    uint32_t index = stack.back();
+    stack.pop_back();
+    const node_t &current = nodes[index];
+    if(current.count)
+    {
+      ids.insert(ids.end(), prim_ids.begin() + current.first, prim_ids.begin() + current.first + current.count);
+      continue;
+    }
+    stack.push_back(current.right);
+    stack.push_back(current.left);
+  }
+}
+
+void scppr::bvh_t::query(const frustum_t &frustum, std::vector<uint32_t> &ids)
+{
+  if(root == UINT32_MAX)
+  {
+    return;
+  }
+  // inserts do not keep the tree balanced, so the stack grows as needed
+  stack.clear();
+  stack.push_back(root);
+  while(!stack.empty())
+  {
+    uint32_t index = stack.back();
+    stack.pop_back();
+    const node_t &node = nodes[index];
+    int side = classify(frustum, node.box);
+    if(side < 0)
+    {
+      continue;
+    }
+    if(side > 0)
+    {
+      collect(index, ids);
+      continue;
+    }
+    if(node.count)
+    {
+      for(uint32_t i = node.first; i < node.first + node.count; i++)
+      {
+        if(classify(frustum, prim_boxes[i]) >= 0)
+        {
+          ids.push_back(prim_ids[i]);
+        }
+      }
+      continue;
+    }
+    stack.push_back(node.right);
+    stack.push_back(node.left);
+  }
+}
+
+void scppr::bvh_t::raycast(glm::vec3 origin, glm::vec3 direction, std::vector<std::pair<float, uint32_t>> &hits)
+{
+  if(root == UINT32_MAX)
+  {
+    return;
+  }
+  glm::vec3 inverse_direction = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+  stack.clear();
+  stack.push_back(root);
+  while(!stack.empty())
+  {
+    uint32_t index = stack.back();
+    stack.pop_back();
+    const node_t &node = nodes[index];
+    if(ray_box(origin, inverse_direction, node.box) < 0)
+    {
+      continue;
+    }
+    if(node.count)
+    {
+      for(uint32_t i = node.first; i < node.first + node.count; i++)
+      {
+        float t = ray_box(origin, inverse_direction, prim_boxes[i]);
+        if(t >= 0)
+        {
+          hits.push_back(std::pair<float, uint32_t>(t, prim_ids[i]));
+        }
+      }
+      continue;
+    }
+    stack.push_back(node.right);
+    stack.push_back(node.left);
+  }
+}
+
+float scppr::ray_triangle(glm::vec3 origin, glm::vec3 direction, glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+  // moller trumbore
+  glm::vec3 ab = b - a;
+  glm::vec3 ac = c - a;
+  glm::vec3 p = glm::cross(direction, ac);
+  float determinant = glm::dot(ab, p);
+  if(std::fabs(determinant) < 1e-12f)
+  {
+    return -1;
+  }
+  float inverse_determinant = 1.0f / determinant;
+  glm::vec3 s = origin - a;
+  float u = glm::dot(s, p) * inverse_determinant;
+  if(u < 0 || u > 1)
+  {
+    return -1;
+  }
+  glm::vec3 q = glm::cross(s, ab);
+  float v = glm::dot(direction, q) * inverse_determinant;
+  if(v < 0 || u + v > 1)
+  {
+    return -1;
+  }
+  return glm::dot(ac, q) * inverse_determinant;
+}
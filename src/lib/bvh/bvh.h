@@ -0,0 +1,72 @@
+#ifndef SCPPR_LIB_BVH_BVH_H
+#define SCPPR_LIB_BVH_BVH_H
+
+#include "lib/cull/cull.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace scppr
+{
+  // bounding volume hierarchy over world space boxes, keyed by caller chosen ids
+  // built top down with median splits, moved boxes are refit bottom up without changing the topology
+  // single boxes can be inserted next to the node they grow least and removed again without a build
+  class bvh_t
+  {
+  public:
+    void build(const std::vector<uint32_t> &ids, const std::vector<box_t> &boxes);
+    // builds again over the boxes it already holds, once refits or inserts have made the tree loose
+    void rebuild();
+    void clear();
+    bool contains(uint32_t id);
+    size_t size();
+    // refits instead when the id is already there
+    void insert(uint32_t id, const box_t &box);
+    void remove(uint32_t id);
+    void refit(uint32_t id, const box_t &box);
+    // surface area of the root compared to right after the last build
+    float growth();
+    // inserts and removes since the last build
+    size_t changes();
+    // appends the ids of every box touching the frustum
+    void query(const frustum_t &frustum, std::vector<uint32_t> &ids);
+    // appends the ids of every box the ray hits with the distance it enters at
+    void raycast(glm::vec3 origin, glm::vec3 direction, std::vector<std::pair<float, uint32_t>> &hits);
+  private:
+    struct node_t
+    {
+      box_t box;
+      uint32_t parent;
+      // children of inner nodes
+      uint32_t left;
+      uint32_t right;
+      // primitives of leaves, a range of the prim arrays, 0 for inner nodes
+      uint32_t first;
+      uint32_t count;
+    };
+    uint32_t build_node(uint32_t begin, uint32_t end, uint32_t parent);
+    uint32_t allocate_node();
+    // recomputes the boxes from index up to the root
+    void refit_from(uint32_t index);
+    void collect(uint32_t node, std::vector<uint32_t> &ids);
+    std::vector<node_t> nodes;
+    std::vector<uint32_t> free_nodes;
+    uint32_t root = UINT32_MAX;
+    // removed primitives leave holes, inserts fill them first
+    std::vector<uint32_t> prim_ids;
+    std::vector<box_t> prim_boxes;
+    std::vector<uint32_t> prim_leaf;
+    std::vector<uint32_t> free_prims;
+    std::unordered_map<uint32_t, uint32_t> id_to_prim;
+    std::vector<uint32_t> stack;
+    float built_area = 0;
+    size_t changed = 0;
+  };
+
+  // distance along the ray to triangle abc, negative when it is missed
+  float ray_triangle(glm::vec3 origin, glm::vec3 direction, glm::vec3 a, glm::vec3 b, glm::vec3 c);
+}
+
+#endif // SCPPR_LIB_BVH_BVH_H
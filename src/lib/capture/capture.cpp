@@ -0,0 +1,258 @@
+#include "lib/capture/capture.h"
+#include "lib/gl/gl.h"
+#include "lib/log.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace
+{
+  // long enough to never matter, glClientWaitSync is retried until the fence signals
+  const GLuint64 wait_timeout = 100000000;
+
+  // bt.601 limited range in 8 bit fixed point
+  unsigned char luma(int r, int g, int b)
+  {
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+  }
+
+  unsigned char chroma_u(int r, int g, int b)
+  {
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+  }
+
+  unsigned char chroma_v(int r, int g, int b)
+  {
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+  }
+
+  std::vector<unsigned char> to_rgb24(const std::vector<unsigned char> &rgba, int width, int height)
+  {
+    size_t pixels = (size_t)width * height;
+    std::vector<unsigned char> rgb(pixels * 3);
+    for(size_t i = 0; i < pixels; i++)
+    {
+      rgb[i * 3] = rgba[i * 4];
+      rgb[i * 3 + 1] = rgba[i * 4 + 1];
+      rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+    return rgb;
+  }
+
+  std::vector<unsigned char> to_yuv420(const std::vector<unsigned char> &rgba, int width, int height)
+  {
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+    size_t luma_size = (size_t)width * height;
+    size_t chroma_size = (size_t)chroma_width * chroma_height;
+    std::vector<unsigned char> yuv(luma_size + 2 * chroma_size);
+    unsigned char *y_plane = yuv.data();
+    unsigned char *u_plane = y_plane + luma_size;
+    unsigned char *v_plane = u_plane + chroma_size;
+    for(size_t i = 0; i < luma_size; i++)
+    {
+      y_plane[i] = luma(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2]);
+    }
+    // chroma of the averaged 2x2 block, the last row and column repeat on odd sizes
+    for(int cy = 0; cy < chroma_height; cy++)
+    {
+      int rows[2] = {cy * 2, std::min(cy * 2 + 1, height - 1)};
+      for(int cx = 0; cx < chroma_width; cx++)
+      {
+        int columns[2] = {cx * 2, std::min(cx * 2 + 1, width - 1)};
+        int r = 0, g = 0, b = 0;
+        for(int row : rows)
+        {
+          for(int column : columns)
+          {
+            const unsigned char *pixel = &rgba[((size_t)row * width + column) * 4];
+            r += pixel[0];
+            g += pixel[1];
+            b += pixel[2];
+          }
+        }
+        r = (r + 2) / 4;
+        g = (g + 2) / 4;
+        b = (b + 2) / 4;
+        u_plane[(size_t)cy * chroma_width + cx] = chroma_u(r, g, b);
+        v_plane[(size_t)cy * chroma_width + cx] = chroma_v(r, g, b);
+      }
+    }
+    return yuv;
+  }
+}
+
+scppr::capture_t::capture_t(uint32_t depth, capture_format_t format, capture_callback_t callback)
+{
+  this -> format = format;
+  this -> callback = callback;
+  slots.resize(std::max<uint32_t>(depth, 1));
+  for(auto &slot : slots)
+  {
+    glGenBuffers(1, &slot.buffer);
+  }
+  if(format != capture_rgba)
+  {
+    converters = new job_system_t(SCPPR_CAPTURE_THREADS);
+  }
+  scppr_DEBUG("capturing through " + std::to_string(slots.size()) + " pixel buffers");
+}
+
+scppr::capture_t::~capture_t()
+{
+  flush();
+  // drains the conversions still queued
+  delete converters;
+  for(auto &slot : slots)
+  {
+    gl_delete_buffer(slot.buffer);
+  }
+}
+
+void scppr::capture_t::capture(GLuint framebuffer, int width, int height)
+{
+  if(width <= 0 || height <= 0)
+  {
+    return;
+  }
+  if(in_flight == slots.size())
+  {
+    scppr_DEBUG("capture ring is full, waiting for the oldest frame");
+    finish();
+  }
+  slot_t &slot = slots[head];
+  size_t size = (size_t)width * height * 4;
+  gl_bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  if(slot.size != size)
+  {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    slot.size = size;
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.index = next_index++;
+  slot.width = width;
+  slot.height = height;
+  head = (head + 1) % slots.size();
+  in_flight++;
+}
+
+void scppr::capture_t::poll()
+{
+  while(in_flight)
+  {
+    slot_t &oldest = slots[(head + slots.size() - in_flight) % slots.size()];
+    GLenum state = glClientWaitSync(oldest.fence, 0, 0);
+    if(state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+    {
+      return;
+    }
+    finish();
+  }
+}
+
+void scppr::capture_t::flush()
+{
+  while(in_flight)
+  {
+    finish();
+  }
+  std::unique_lock<std::mutex> lock(delivery_mutex);
+  delivered.wait(lock, [this]() { return next_delivery == next_index && !delivering; });
+}
+
+void scppr::capture_t::finish()
+{
+  slot_t &slot = slots[(head + slots.size() - in_flight) % slots.size()];
+  // the first wait flushes, so the fence is sure to reach the gpu
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  while(true)
+  {
+    GLenum state = glClientWaitSync(slot.fence, flags, wait_timeout);
+    if(state == GL_ALREADY_SIGNALED || state == GL_CONDITION_SATISFIED || state == GL_WAIT_FAILED)
+    {
+      break;
+    }
+    flags = 0;
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = 0;
+  in_flight--;
+
+  captured_frame_t frame;
+  frame.index = slot.index;
+  frame.width = slot.width;
+  frame.height = slot.height;
+  frame.format = capture_rgba;
+  size_t row = (size_t)slot.width * 4;
+  frame.data.resize(slot.size);
+  gl_bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+  const unsigned char *mapped = (const unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+  if(mapped)
+  {
+    // gl has the bottom row first
+    for(int y = 0; y < slot.height; y++)
+    {
+      memcpy(frame.data.data() + y * row, mapped + (size_t)(slot.height - 1 - y) * row, row);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  else
+  {
+    scppr_WARN("cannot map captured frame " + std::to_string(slot.index));
+  }
+  gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if(!converters)
+  {
+    deliver(frame);
+    return;
+  }
+  converters -> submit([this, frame]() mutable
+  {
+    if(format == capture_rgb24)
+    {
+      frame.data = to_rgb24(frame.data, frame.width, frame.height);
+    }
+    else
+    {
+      frame.data = to_yuv420(frame.data, frame.width, frame.height);
+    }
+    frame.format = format;
+    deliver(frame);
+  });
+}
+
+void scppr::capture_t::deliver(captured_frame_t &frame)
+{
+  std::unique_lock<std::mutex> lock(delivery_mutex);
+  finished.emplace(frame.index, std::move(frame));
+  // one thread hands frames over at a time, a frame converted early waits for the ones before it
+  if(delivering)
+  {
+    return;
+  }
+  delivering = true;
+  for(auto next = finished.find(next_delivery); next != finished.end(); next = finished.find(next_delivery))
+  {
+    captured_frame_t ready = std::move(next -> second);
+    finished.erase(next);
+    // the callback may call back into the renderer, so the lock is not held around it
+    lock.unlock();
+    try
+    {
+      callback(ready);
+    }
+    catch(const std::exception &e)
+    {
+      scppr_ERROR("capture callback failed on frame " + std::to_string(ready.index) + ": " + e.what());
+    }
+    lock.lock();
+    next_delivery++;
+  }
+  delivering = false;
+  delivered.notify_all();
+}
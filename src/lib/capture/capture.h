@@ -0,0 +1,92 @@
+#ifndef SCPPR_LIB_CAPTURE_CAPTURE_H
+#define SCPPR_LIB_CAPTURE_CAPTURE_H
+
+#include "lib/glad.h"
+#include "lib/job/job.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace scppr
+{
+  // frames in flight when none are asked for
+  static const uint32_t SCPPR_CAPTURE_DEPTH = 3;
+  // threads converting captured frames, frames still reach the callback in order
+  static const unsigned int SCPPR_CAPTURE_THREADS = 2;
+
+  enum capture_format_t
+  {
+    // as read back, four bytes a pixel
+    capture_rgba,
+    // three bytes a pixel
+    capture_rgb24,
+    // planar i420, the full size y plane then u and v at half size rounded up, bt.601 limited range
+    capture_yuv420
+  };
+
+  struct captured_frame_t
+  {
+    // counts captured frames from 0
+    uint64_t index;
+    int width;
+    int height;
+    capture_format_t format;
+    // top row first, rows tightly packed
+    std::vector<unsigned char> data;
+  };
+
+  // the frame may be moved out of, rgba frames are handed over on the gl thread and converted ones on a converter thread
+  // runs without any lock of the capture held, one frame at a time
+  typedef std::function<void(captured_frame_t &)> capture_callback_t;
+
+  // reads frames back through a ring of pixel pack buffers without waiting for the gpu
+  // every capture fences its copy, poll maps the copies that are done and passes them on
+  // only waits when depth frames are in flight, so nothing gets dropped
+  class capture_t
+  {
+  public:
+    capture_t(uint32_t depth, capture_format_t format, capture_callback_t callback);
+    // flushes what is still in flight, needs the context
+    ~capture_t();
+    // gl thread, queues a copy of the color buffer read from framebuffer, 0 being the back buffer of the window
+    void capture(GLuint framebuffer, int width, int height);
+    // gl thread, passes on the frames whose copy finished
+    void poll();
+    // gl thread, waits for every frame in flight and its conversion
+    void flush();
+  private:
+    struct slot_t
+    {
+      GLuint buffer = 0;
+      size_t size = 0;
+      GLsync fence = 0;
+      uint64_t index;
+      int width;
+      int height;
+    };
+    // maps the oldest slot, copies its frame out and frees it
+    void finish();
+    // hands frames to the callback in index order, whichever thread finished them
+    void deliver(captured_frame_t &frame);
+    std::vector<slot_t> slots;
+    // next slot to write and slots in flight behind it
+    size_t head = 0;
+    size_t in_flight = 0;
+    uint64_t next_index = 0;
+    capture_format_t format;
+    capture_callback_t callback;
+    std::mutex delivery_mutex;
+    std::map<uint64_t, captured_frame_t> finished;
+    uint64_t next_delivery = 0;
+    // set while a thread runs the callback, frames finished meanwhile are left to it
+    bool delivering = false;
+    std::condition_variable delivered;
+    // only for converted formats
+    job_system_t *converters = NULL;
+  };
+}
+
+#endif // SCPPR_LIB_CAPTURE_CAPTURE_H
@@ -0,0 +1,66 @@
+#include "lib/cull/cull.h"
+#include <cmath>
+
+scppr::frustum_t scppr::make_frustum(const glm::dmat4 &vp)
+{
+  frustum_t frustum;
+  glm::dvec4 row[4];
+  for(int i = 0; i < 4; i++)
+  {
+    row[i] = glm::dvec4(vp[0][i], vp[1][i], vp[2][i], vp[3][i]);
+  }
+  glm::dvec4 planes[6] =
+  {
+    row[3] + row[0],
+    row[3] - row[0],
+    row[3] + row[1],
+    row[3] - row[1],
+    row[3] + row[2],
+    row[3] - row[2]
+  };
+  for(int i = 0; i < 6; i++)
+  {
+    double length = glm::length(glm::dvec3(planes[i]));
+    frustum.planes[i] = planes[i] / length;
+  }
+  return frustum;
+}
+
+bool scppr::intersects(const frustum_t &frustum, const bounds_t &bounds, const glm::mat4 &model)
+{
+  glm::vec3 axis[3] = {glm::vec3(model[0]), glm::vec3(model[1]), glm::vec3(model[2])};
+  glm::vec3 center = glm::vec3(model * glm::vec4(bounds.center, 1));
+  float scale = std::sqrt(std::fmax(glm::dot(axis[0], axis[0]), std::fmax(glm::dot(axis[1], axis[1]), glm::dot(axis[2], axis[2]))));
+  float radius = bounds.radius * scale;
+
+  // the box is moved into the world as centre and half extents along the world axes
+  glm::vec3 box_center = glm::vec3(model * glm::vec4((bounds.min + bounds.max) * 0.5f, 1));
+  glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+  glm::vec3 extent = glm::abs(axis[0]) * half.x + glm::abs(axis[1]) * half.y + glm::abs(axis[2]) * half.z;
+
+  for(int i = 0; i < 6; i++)
+  {
+    glm::vec3 normal = glm::vec3(frustum.planes[i]);
+    float w = frustum.planes[i].w;
+    if(glm::dot(normal, center) + w < -radius)
+    {
+      return false;
+    }
+    if(glm::dot(normal, box_center) + w < -glm::dot(glm::abs(normal), extent))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+scppr::box_t scppr::world_box(const bounds_t &bounds, const glm::mat4 &model)
+{
+  glm::vec3 center = glm::vec3(model * glm::vec4((bounds.min + bounds.max) * 0.5f, 1));
+  glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+  glm::vec3 extent = glm::abs(glm::vec3(model[0])) * half.x + glm::abs(glm::vec3(model[1])) * half.y + glm::abs(glm::vec3(model[2])) * half.z;
+  box_t box;
+  box.min = center - extent;
+  box.max = center + extent;
+  return box;
+}
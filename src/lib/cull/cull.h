@@ -0,0 +1,38 @@
+#ifndef SCPPR_LIB_CULL_CULL_H
+#define SCPPR_LIB_CULL_CULL_H
+
+#include <glm/glm.hpp>
+
+namespace scppr
+{
+  // axis aligned box and sphere around the same geometry, in model space
+  struct bounds_t
+  {
+    glm::vec3 min = {0, 0, 0};
+    glm::vec3 max = {0, 0, 0};
+    glm::vec3 center = {0, 0, 0};
+    float radius = 0;
+  };
+
+  // world space axis aligned box
+  struct box_t
+  {
+    glm::vec3 min;
+    glm::vec3 max;
+  };
+
+  // planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+  struct frustum_t
+  {
+    glm::vec4 planes[6];
+  };
+
+  // extracts the planes of projection * view
+  frustum_t make_frustum(const glm::dmat4 &vp);
+  // tests bounds placed in the world by model, conservative
+  bool intersects(const frustum_t &frustum, const bounds_t &bounds, const glm::mat4 &model);
+  // box around bounds placed in the world by model
+  box_t world_box(const bounds_t &bounds, const glm::mat4 &model);
+}
+
+#endif // SCPPR_LIB_CULL_CULL_H
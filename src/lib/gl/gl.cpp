@@ -0,0 +1,397 @@
+#include "lib/gl/gl.h"
+#include "lib/log.h"
+#include <map>
+#include <string>
+
+namespace
+{
+  const GLuint unknown = UINT32_MAX;
+
+  // buffer targets that are cached, anything else goes straight through
+  const GLenum buffer_targets[] = {GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_DRAW_INDIRECT_BUFFER};
+  const GLenum buffer_queries[] = {GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_PIXEL_PACK_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING, GL_DRAW_INDIRECT_BUFFER_BINDING};
+  const int buffer_slots = sizeof(buffer_targets) / sizeof(buffer_targets[0]);
+
+  const GLenum texture_targets[] = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY};
+  const GLenum texture_queries[] = {GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY};
+  const int texture_slots = sizeof(texture_targets) / sizeof(texture_targets[0]);
+
+  struct state_t
+  {
+    GLuint program;
+    GLuint vao;
+    GLuint buffers[buffer_slots];
+    GLenum active_texture;
+    GLuint textures[scppr::SCPPR_GL_TEXTURE_UNITS][texture_slots];
+    // 0 disabled, 1 enabled, missing unknown
+    std::map<GLenum, int> capabilities;
+    GLenum depth_func;
+    GLenum blend_source;
+    GLenum blend_destination;
+    bool viewport_known;
+    GLint viewport[4];
+    bool clear_color_known;
+    GLfloat clear_color[4];
+    uint32_t changes = 0;
+  };
+
+  state_t state;
+
+  int buffer_slot(GLenum target)
+  {
+    for(int i = 0; i < buffer_slots; i++)
+    {
+      if(buffer_targets[i] == target)
+      {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  int texture_slot(GLenum target)
+  {
+    for(int i = 0; i < texture_slots; i++)
+    {
+      if(texture_targets[i] == target)
+      {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  void validate()
+  {
+#ifdef SCPPR_GL_STATE_VALIDATE
+    scppr::gl_validate();
+#endif
+  }
+
+  void check(GLuint cached, GLint actual, const char *what)
+  {
+    if(cached == unknown)
+    {
+      return;
+    }
+    scppr_ASSERT(cached == (GLuint)actual, std::string("gl state cache out of step: ") + what + " cached " + std::to_string(cached) + " actual " + std::to_string(actual));
+  }
+
+  // the cache starts out unknown, it is not tied to a context and never assumes defaults
+  struct reset_t
+  {
+    reset_t()
+    {
+      scppr::gl_reset();
+    }
+  } reset_on_load;
+}
+
+void scppr::gl_reset()
+{
+  state.program = unknown;
+  state.vao = unknown;
+  for(int i = 0; i < buffer_slots; i++)
+  {
+    state.buffers[i] = unknown;
+  }
+  state.active_texture = unknown;
+  for(int unit = 0; unit < SCPPR_GL_TEXTURE_UNITS; unit++)
+  {
+    for(int i = 0; i < texture_slots; i++)
+    {
+      state.textures[unit][i] = unknown;
+    }
+  }
+  state.capabilities.clear();
+  state.depth_func = unknown;
+  state.blend_source = unknown;
+  state.blend_destination = unknown;
+  state.viewport_known = false;
+  state.clear_color_known = false;
+}
+
+void scppr::gl_use_program(GLuint program)
+{
+  if(state.program == program)
+  {
+    return;
+  }
+  glUseProgram(program);
+  state.program = program;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_bind_vertex_array(GLuint vao)
+{
+  if(state.vao == vao)
+  {
+    return;
+  }
+  glBindVertexArray(vao);
+  state.vao = vao;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_bind_buffer(GLenum target, GLuint buffer)
+{
+  int slot = buffer_slot(target);
+  if(slot >= 0 && state.buffers[slot] == buffer)
+  {
+    return;
+  }
+  glBindBuffer(target, buffer);
+  if(slot >= 0)
+  {
+    state.buffers[slot] = buffer;
+  }
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_bind_buffer_base(GLenum target, GLuint index, GLuint buffer)
+{
+  glBindBufferBase(target, index, buffer);
+  int slot = buffer_slot(target);
+  if(slot >= 0)
+  {
+    state.buffers[slot] = buffer;
+  }
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_active_texture(GLenum unit)
+{
+  if(state.active_texture == unit)
+  {
+    return;
+  }
+  glActiveTexture(unit);
+  state.active_texture = unit;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_bind_texture(GLenum target, GLuint texture)
+{
+  int slot = texture_slot(target);
+  GLuint unit = state.active_texture - GL_TEXTURE0;
+  bool cached = slot >= 0 && state.active_texture != unknown && unit < SCPPR_GL_TEXTURE_UNITS;
+  if(cached && state.textures[unit][slot] == texture)
+  {
+    return;
+  }
+  glBindTexture(target, texture);
+  if(cached)
+  {
+    state.textures[unit][slot] = texture;
+  }
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_bind_texture_unit(GLuint unit, GLenum target, GLuint texture)
+{
+  int slot = texture_slot(target);
+  if(slot >= 0 && unit < SCPPR_GL_TEXTURE_UNITS && state.textures[unit][slot] == texture)
+  {
+    return;
+  }
+  gl_active_texture(GL_TEXTURE0 + unit);
+  gl_bind_texture(target, texture);
+}
+
+void scppr::gl_enable(GLenum capability)
+{
+  auto it = state.capabilities.find(capability);
+  if(it != state.capabilities.end() && it -> second == 1)
+  {
+    return;
+  }
+  glEnable(capability);
+  state.capabilities[capability] = 1;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_disable(GLenum capability)
+{
+  auto it = state.capabilities.find(capability);
+  if(it != state.capabilities.end() && it -> second == 0)
+  {
+    return;
+  }
+  glDisable(capability);
+  state.capabilities[capability] = 0;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_depth_func(GLenum func)
+{
+  if(state.depth_func == func)
+  {
+    return;
+  }
+  glDepthFunc(func);
+  state.depth_func = func;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_blend_func(GLenum source, GLenum destination)
+{
+  if(state.blend_source == source && state.blend_destination == destination)
+  {
+    return;
+  }
+  glBlendFunc(source, destination);
+  state.blend_source = source;
+  state.blend_destination = destination;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  if(state.viewport_known && state.viewport[0] == x && state.viewport[1] == y && state.viewport[2] == width && state.viewport[3] == height)
+  {
+    return;
+  }
+  glViewport(x, y, width, height);
+  state.viewport_known = true;
+  state.viewport[0] = x;
+  state.viewport[1] = y;
+  state.viewport[2] = width;
+  state.viewport[3] = height;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_clear_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+  if(state.clear_color_known && state.clear_color[0] == red && state.clear_color[1] == green && state.clear_color[2] == blue && state.clear_color[3] == alpha)
+  {
+    return;
+  }
+  glClearColor(red, green, blue, alpha);
+  state.clear_color_known = true;
+  state.clear_color[0] = red;
+  state.clear_color[1] = green;
+  state.clear_color[2] = blue;
+  state.clear_color[3] = alpha;
+  state.changes++;
+  validate();
+}
+
+void scppr::gl_delete_program(GLuint program)
+{
+  glDeleteProgram(program);
+  // a bound program stays in use until it is replaced, the name just becomes free
+  if(state.program == program)
+  {
+    state.program = unknown;
+  }
+}
+
+void scppr::gl_delete_vertex_array(GLuint vao)
+{
+  glDeleteVertexArrays(1, &vao);
+  if(state.vao == vao)
+  {
+    state.vao = 0;
+  }
+}
+
+void scppr::gl_delete_buffer(GLuint buffer)
+{
+  glDeleteBuffers(1, &buffer);
+  for(int i = 0; i < buffer_slots; i++)
+  {
+    if(state.buffers[i] == buffer)
+    {
+      state.buffers[i] = 0;
+    }
+  }
+}
+
+void scppr::gl_delete_texture(GLuint texture)
+{
+  glDeleteTextures(1, &texture);
+  for(int unit = 0; unit < SCPPR_GL_TEXTURE_UNITS; unit++)
+  {
+    for(int i = 0; i < texture_slots; i++)
+    {
+      if(state.textures[unit][i] == texture)
+      {
+        state.textures[unit][i] = 0;
+      }
+    }
+  }
+}
+
+uint32_t scppr::gl_take_state_changes()
+{
+  uint32_t changes = state.changes;
+  state.changes = 0;
+  return changes;
+}
+
+void scppr::gl_validate()
+{
+  GLint value;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+  check(state.program, value, "program");
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+  check(state.vao, value, "vertex array");
+  for(int i = 0; i < buffer_slots; i++)
+  {
+    glGetIntegerv(buffer_queries[i], &value);
+    check(state.buffers[i], value, "buffer");
+  }
+  GLint active;
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+  check(state.active_texture, active, "active texture");
+  for(int unit = 0; unit < SCPPR_GL_TEXTURE_UNITS; unit++)
+  {
+    // switching units directly keeps the cache as it is
+    glActiveTexture(GL_TEXTURE0 + unit);
+    for(int i = 0; i < texture_slots; i++)
+    {
+      glGetIntegerv(texture_queries[i], &value);
+      check(state.textures[unit][i], value, "texture");
+    }
+  }
+  glActiveTexture(active);
+  for(auto &capability : state.capabilities)
+  {
+    check(capability.second, glIsEnabled(capability.first), "capability");
+  }
+  glGetIntegerv(GL_DEPTH_FUNC, &value);
+  check(state.depth_func, value, "depth func");
+  glGetIntegerv(GL_BLEND_SRC_RGB, &value);
+  check(state.blend_source, value, "blend source");
+  glGetIntegerv(GL_BLEND_DST_RGB, &value);
+  check(state.blend_destination, value, "blend destination");
+  if(state.viewport_known)
+  {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    for(int i = 0; i < 4; i++)
+    {
+      check(state.viewport[i], viewport[i], "viewport");
+    }
+  }
+  if(state.clear_color_known)
+  {
+    GLfloat clear_color[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear_color);
+    for(int i = 0; i < 4; i++)
+    {
+      scppr_ASSERT(state.clear_color[i] == clear_color[i], "gl state cache out of step: clear color");
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef SCPPR_LIB_GL_GL_H
+#define SCPPR_LIB_GL_GL_H
+
+#include "lib/glad.h"
+#include <cstdint>
+
+namespace scppr
+{
+  // thin cache in front of the gl state that scppr touches, calls that would not change anything never reach the driver
+  // everything runs on the thread owning the context
+  // element array buffer binds are vertex array state and always go through
+  // built with SCPPR_GL_STATE_VALIDATE every call checks the cache against glGet* afterwards
+  static const int SCPPR_GL_TEXTURE_UNITS = 16;
+
+  // forgets everything, the next call of each kind goes through, needed after someone else touched the context
+  void gl_reset();
+  void gl_use_program(GLuint program);
+  void gl_bind_vertex_array(GLuint vao);
+  void gl_bind_buffer(GLenum target, GLuint buffer);
+  // always goes through, also sets the generic binding of target
+  void gl_bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+  void gl_active_texture(GLenum unit);
+  // binds to the active unit
+  void gl_bind_texture(GLenum target, GLuint texture);
+  // active_texture and bind_texture in one
+  void gl_bind_texture_unit(GLuint unit, GLenum target, GLuint texture);
+  void gl_enable(GLenum capability);
+  void gl_disable(GLenum capability);
+  void gl_depth_func(GLenum func);
+  void gl_blend_func(GLenum source, GLenum destination);
+  void gl_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  void gl_clear_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+  // deleting a bound object unbinds it, these keep the cache in step
+  void gl_delete_program(GLuint program);
+  void gl_delete_vertex_array(GLuint vao);
+  void gl_delete_buffer(GLuint buffer);
+  void gl_delete_texture(GLuint texture);
+  // state changes issued since the last call
+  uint32_t gl_take_state_changes();
+  // compares every cached value with the context, asserts on a mismatch
+  void gl_validate();
+}
+
+#endif // SCPPR_LIB_GL_GL_H
@@ -0,0 +1,165 @@
+#include "lib/job/job.h"
+#include <algorithm>
+
+namespace
+{
+  // queue owned by the current thread, or none for threads outside the pool
+  thread_local int worker_index = -1;
+  thread_local const void *worker_pool = NULL;
+}
+
+scppr::job_system_t::job_system_t(unsigned int workers)
+{
+  if(workers == 0)
+  {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    workers = hardware > 1 ? hardware - 1 : 1;
+  }
+  for(unsigned int i = 0; i < workers; i++)
+  {
+    queues.push_back(new queue_t());
+  }
+  for(unsigned int i = 0; i < workers; i++)
+  {
+    this -> workers.emplace_back(&job_system_t::run, this, i);
+  }
+}
+
+scppr::job_system_t::~job_system_t()
+{
+  shutdown();
+  for(auto queue : queues)
+  {
+    delete queue;
+  }
+}
+
+void scppr::job_system_t::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for(auto &worker : workers)
+  {
+    worker.join();
+  }
+  workers.clear();
+}
+
+void scppr::job_system_t::submit(std::function<void()> job)
+{
+  push(std::move(job));
+}
+
+void scppr::job_system_t::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &function)
+{
+  if(grain == 0)
+  {
+    grain = 1;
+  }
+  if(count <= grain)
+  {
+    if(count)
+    {
+      function(0, count);
+    }
+    return;
+  }
+  size_t chunks = (count + grain - 1) / grain;
+  std::atomic<size_t> remaining(chunks - 1);
+  for(size_t chunk = 1; chunk < chunks; chunk++)
+  {
+    size_t begin = chunk * grain;
+    size_t end = std::min(count, begin + grain);
+    push([&function, &remaining, begin, end]()
+    {
+      function(begin, end);
+      remaining.fetch_sub(1, std::memory_order_release);
+    });
+  }
+  function(0, grain);
+  // help with whatever is queued until our chunks are done
+  std::function<void()> job;
+  while(remaining.load(std::memory_order_acquire))
+  {
+    if(take(worker_pool == this ? worker_index : 0, job))
+    {
+      job();
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+unsigned int scppr::job_system_t::worker_count()
+{
+  return workers.size();
+}
+
+void scppr::job_system_t::push(std::function<void()> job)
+{
+  unsigned int index = worker_pool == this ? worker_index : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+  {
+    std::lock_guard<std::mutex> lock(queues[index] -> mutex);
+    queues[index] -> jobs.push_back(std::move(job));
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    pending.fetch_add(1);
+  }
+  wake.notify_one();
+}
+
+bool scppr::job_system_t::take(unsigned int index, std::function<void()> &job)
+{
+  {
+    queue_t *own = queues[index];
+    std::lock_guard<std::mutex> lock(own -> mutex);
+    if(!own -> jobs.empty())
+    {
+      job = std::move(own -> jobs.back());
+      own -> jobs.pop_back();
+      pending.fetch_sub(1);
+      return true;
+    }
+  }
+  for(size_t i = 1; i < queues.size(); i++)
+  {
+    queue_t *victim = queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim -> mutex);
+    if(!victim -> jobs.empty())
+    {
+      job = std::move(victim -> jobs.front());
+      victim -> jobs.pop_front();
+      pending.fetch_sub(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+void scppr::job_system_t::run(unsigned int index)
+{
+  worker_index = index;
+  worker_pool = this;
+  std::function<void()> job;
+  while(true)
+  {
+    if(take(index, job))
+    {
+      job();
+      job = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    wake.wait(lock, [this]() { return stopping || pending.load() > 0; });
+    if(stopping && pending.load() == 0)
+    {
+      break;
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef SCPPR_LIB_JOB_JOB_H
+#define SCPPR_LIB_JOB_JOB_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace scppr
+{
+  // small work stealing thread pool
+  // every worker owns a deque, it pops its own jobs from the back and steals from the front of the others
+  class job_system_t
+  {
+  public:
+    // 0 picks one worker per hardware thread, minus the calling thread
+    job_system_t(unsigned int workers = 0);
+    ~job_system_t();
+    // runs what is still queued and joins the workers, nothing may be submitted afterwards
+    void shutdown();
+    // runs the job on a worker some time later
+    void submit(std::function<void()> job);
+    // runs function(begin, end) over [0, count) in chunks of grain, chunk k starts at k * grain
+    // the calling thread helps out and the call returns once every chunk has run
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)> &function);
+    unsigned int worker_count();
+  private:
+    struct queue_t
+    {
+      std::mutex mutex;
+      std::deque<std::function<void()>> jobs;
+    };
+    void run(unsigned int index);
+    void push(std::function<void()> job);
+    bool take(unsigned int index, std::function<void()> &job);
+    std::vector<queue_t *> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned int> next_queue{0};
+    std::atomic<size_t> pending{0};
+    bool stopping = false;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+  };
+}
+
+#endif // SCPPR_LIB_JOB_JOB_H
@@ -0,0 +1,279 @@
+#include "lib/lod/lod.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+  // collapses per pass are limited to vertices no other collapse touched, so a few passes are needed
+  const int max_passes = 16;
+
+  // symmetric 4x4 matrix summing squared distances to planes, upper triangle only
+  struct quadric_t
+  {
+    double xx = 0, xy = 0, xz = 0, xw = 0;
+    double yy = 0, yz = 0, yw = 0;
+    double zz = 0, zw = 0;
+    double ww = 0;
+
+    void add(const quadric_t &other)
+    {
+      xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+      yy += other.yy; yz += other.yz; yw += other.yw;
+      zz += other.zz; zw += other.zw;
+      ww += other.ww;
+    }
+
+    // plane through point with unit normal
+    void add_plane(const glm::dvec3 &normal, const glm::dvec3 &point)
+    {
+      double d = -glm::dot(normal, point);
+      xx += normal.x * normal.x; xy += normal.x * normal.y; xz += normal.x * normal.z; xw += normal.x * d;
+      yy += normal.y * normal.y; yz += normal.y * normal.z; yw += normal.y * d;
+      zz += normal.z * normal.z; zw += normal.z * d;
+      ww += d * d;
+    }
+
+    double evaluate(const glm::dvec3 &p) const
+    {
+      double result = xx * p.x * p.x + 2 * xy * p.x * p.y + 2 * xz * p.x * p.z + 2 * xw * p.x
+        + yy * p.y * p.y + 2 * yz * p.y * p.z + 2 * yw * p.y
+        + zz * p.z * p.z + 2 * zw * p.z
+        + ww;
+      return std::max(result, 0.0);
+    }
+  };
+
+  struct collapse_t
+  {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+  };
+
+  uint64_t edge_key(uint32_t a, uint32_t b)
+  {
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+  }
+}
+
+std::vector<uint32_t> scppr::simplify(const std::vector<uint32_t> &indices, const float *positions, size_t vertex_count, size_t stride, size_t target_index_count, float &error)
+{
+  error = 0;
+  std::vector<uint32_t> result = indices;
+  if(result.size() <= target_index_count)
+  {
+    return result;
+  }
+  auto position = [&](uint32_t vertex)
+  {
+    const float *p = (const float *)((const char *)positions + vertex * stride);
+    return glm::dvec3(p[0], p[1], p[2]);
+  };
+
+  // vertices sharing a position with another one sit on a seam, moving one of them would tear it open
+  std::vector<bool> locked(vertex_count, false);
+  std::unordered_map<std::string, uint32_t> by_position;
+  for(uint32_t vertex = 0; vertex < vertex_count; vertex++)
+  {
+    std::string key((const char *)positions + vertex * stride, 3 * sizeof(float));
+    auto inserted = by_position.emplace(key, vertex);
+    if(!inserted.second)
+    {
+      locked[vertex] = true;
+      locked[inserted.first -> second] = true;
+    }
+  }
+  // edges used by a single triangle are open borders, collapsing them would eat into the outline
+  std::unordered_map<uint64_t, uint32_t> edge_uses;
+  for(size_t i = 0; i + 2 < result.size(); i += 3)
+  {
+    for(int corner = 0; corner < 3; corner++)
+    {
+      edge_uses[edge_key(result[i + corner], result[i + (corner + 1) % 3])]++;
+    }
+  }
+  for(auto &edge : edge_uses)
+  {
+    if(edge.second == 1)
+    {
+      locked[edge.first >> 32] = true;
+      locked[edge.first & 0xffffffff] = true;
+    }
+  }
+
+  std::vector<quadric_t> quadrics(vertex_count);
+  for(size_t i = 0; i + 2 < result.size(); i += 3)
+  {
+    glm::dvec3 a = position(result[i]);
+    glm::dvec3 normal = glm::cross(position(result[i + 1]) - a, position(result[i + 2]) - a);
+    double length = glm::length(normal);
+    if(length == 0)
+    {
+      continue;
+    }
+    quadric_t plane;
+    plane.add_plane(normal / length, a);
+    for(int corner = 0; corner < 3; corner++)
+    {
+      quadrics[result[i + corner]].add(plane);
+    }
+  }
+
+  double worst = 0;
+  std::vector<collapse_t> collapses;
+  std::vector<uint32_t> remap(vertex_count);
+  std::vector<bool> touched(vertex_count);
+  // triangles around every vertex, rebuilt each pass
+  std::vector<uint32_t> first_triangle(vertex_count + 1);
+  std::vector<uint32_t> triangles;
+  for(int pass = 0; pass < max_passes && result.size() > target_index_count; pass++)
+  {
+    std::fill(first_triangle.begin(), first_triangle.end(), 0);
+    for(auto vertex : result)
+    {
+      first_triangle[vertex + 1]++;
+    }
+    for(size_t vertex = 0; vertex < vertex_count; vertex++)
+    {
+      first_triangle[vertex + 1] += first_triangle[vertex];
+    }
+    triangles.resize(result.size());
+    std::vector<uint32_t> fill(first_triangle.begin(), first_triangle.end() - 1);
+    for(size_t i = 0; i < result.size(); i++)
+    {
+      triangles[fill[result[i]]++] = i / 3;
+    }
+
+    // the cheaper way round of every edge, the vertex moved onto its neighbour
+    collapses.clear();
+    for(size_t i = 0; i + 2 < result.size(); i += 3)
+    {
+      for(int corner = 0; corner < 3; corner++)
+      {
+        uint32_t a = result[i + corner];
+        uint32_t b = result[i + (corner + 1) % 3];
+        quadric_t q = quadrics[a];
+        q.add(quadrics[b]);
+        if(!locked[a])
+        {
+          collapses.push_back({q.evaluate(position(b)), a, b});
+        }
+        if(!locked[b])
+        {
+          collapses.push_back({q.evaluate(position(a)), b, a});
+        }
+      }
+    }
+    if(collapses.empty())
+    {
+      break;
+    }
+    std::sort(collapses.begin(), collapses.end(), [](const collapse_t &a, const collapse_t &b)
+    {
+      return a.cost < b.cost;
+    });
+
+    for(uint32_t vertex = 0; vertex < vertex_count; vertex++)
+    {
+      remap[vertex] = vertex;
+    }
+    std::fill(touched.begin(), touched.end(), false);
+    // a collapse removes the two triangles along its edge
+    size_t excess = (result.size() - target_index_count) / 3;
+    size_t removed = 0;
+    for(auto &collapse : collapses)
+    {
+      if(removed >= excess)
+      {
+        break;
+      }
+      if(touched[collapse.from] || touched[collapse.to])
+      {
+        continue;
+      }
+      // a triangle turning over would show its back
+      bool flips = false;
+      glm::dvec3 target = position(collapse.to);
+      for(uint32_t t = first_triangle[collapse.from]; t < first_triangle[collapse.from + 1] && !flips; t++)
+      {
+        const uint32_t *triangle = &result[triangles[t] * 3];
+        if(triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+        {
+          continue;
+        }
+        glm::dvec3 corners[3];
+        glm::dvec3 moved[3];
+        for(int corner = 0; corner < 3; corner++)
+        {
+          corners[corner] = position(triangle[corner]);
+          moved[corner] = triangle[corner] == collapse.from ? target : corners[corner];
+        }
+        glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        flips = glm::dot(before, after) <= 0;
+      }
+      if(flips)
+      {
+        continue;
+      }
+      remap[collapse.from] = collapse.to;
+      touched[collapse.from] = true;
+      touched[collapse.to] = true;
+      quadrics[collapse.to].add(quadrics[collapse.from]);
+      worst = std::max(worst, collapse.cost);
+      removed += 2;
+    }
+    if(!removed)
+    {
+      break;
+    }
+
+    size_t kept = 0;
+    for(size_t i = 0; i + 2 < result.size(); i += 3)
+    {
+      uint32_t a = remap[result[i]];
+      uint32_t b = remap[result[i + 1]];
+      uint32_t c = remap[result[i + 2]];
+      if(a == b || b == c || c == a)
+      {
+        continue;
+      }
+      result[kept++] = a;
+      result[kept++] = b;
+      result[kept++] = c;
+    }
+    result.resize(kept);
+  }
+  // the costs sum squared distances to several planes, so their root overestimates the distance a little
+  error = std::sqrt(worst);
+  return result;
+}
+
+std::vector<scppr::lod_t> scppr::build_lods(std::vector<uint32_t> &indices, const float *positions, size_t vertex_count, size_t stride)
+{
+  std::vector<lod_t> lods;
+  lods.push_back({0, (uint32_t)indices.size(), 0});
+  if(indices.size() / 3 < SCPPR_LOD_MIN_TRIANGLES)
+  {
+    return lods;
+  }
+  for(uint32_t level = 1; level < SCPPR_LOD_LEVELS; level++)
+  {
+    lod_t previous = lods.back();
+    // each level simplifies the one before, which is cheaper and keeps the levels nested
+    std::vector<uint32_t> source(indices.begin() + previous.first_index, indices.begin() + previous.first_index + previous.index_count);
+    float error;
+    std::vector<uint32_t> simplified = simplify(source, positions, vertex_count, stride, previous.index_count / 6 * 3, error);
+    // a level that hardly shrinks is not worth its indices
+    if(simplified.empty() || simplified.size() > previous.index_count * 3 / 4)
+    {
+      break;
+    }
+    lods.push_back({(uint32_t)indices.size(), (uint32_t)simplified.size(), std::max(previous.error, error)});
+    indices.insert(indices.end(), simplified.begin(), simplified.end());
+  }
+  return lods;
+}
@@ -0,0 +1,32 @@
+#ifndef SCPPR_LIB_LOD_LOD_H
+#define SCPPR_LIB_LOD_LOD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace scppr
+{
+  // levels per mesh, the full one included
+  static const uint32_t SCPPR_LOD_LEVELS = 4;
+  // meshes with fewer triangles keep only their full level
+  static const size_t SCPPR_LOD_MIN_TRIANGLES = 256;
+
+  // one level of a mesh, a range of its index buffer, every level shares the vertices
+  struct lod_t
+  {
+    uint32_t first_index;
+    uint32_t index_count;
+    // farthest the simplified surface strays from the full one, in model units
+    float error;
+  };
+
+  // quadric error edge collapse onto existing vertices, so only the triangles change
+  // positions are three floats every stride bytes, vertices on open borders and uv or normal seams stay put
+  // returns at most target_index_count indices unless the locked vertices do not allow it
+  std::vector<uint32_t> simplify(const std::vector<uint32_t> &indices, const float *positions, size_t vertex_count, size_t stride, size_t target_index_count, float &error);
+  // appends levels of about half the triangles of the level before to indices and returns every level, the full one first
+  std::vector<lod_t> build_lods(std::vector<uint32_t> &indices, const float *positions, size_t vertex_count, size_t stride);
+}
+
+#endif // SCPPR_LIB_LOD_LOD_H
@@ -0,0 +1,180 @@
+#include "lib/log.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+std::atomic<int> scppr::_log_level(scppr::log_info);
+
+namespace
+{
+  // bounded multi producer single consumer queue, see
+  // http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+  const size_t queue_size = 1024;
+
+  struct slot_t
+  {
+    std::atomic<size_t> sequence;
+    scppr::log_level_t level;
+    std::string msg;
+  };
+
+  class sink_t
+  {
+  public:
+    sink_t()
+    {
+      for(size_t i = 0; i < queue_size; i++)
+      {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      writer = std::thread(&sink_t::run, this);
+    }
+
+    ~sink_t()
+    {
+      running.store(false);
+      wake.notify_one();
+      writer.join();
+    }
+
+    void push(scppr::log_level_t level, std::string &msg)
+    {
+      size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+      slot_t *slot;
+      while(true)
+      {
+        slot = &slots[pos % queue_size];
+        size_t sequence = slot -> sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if(diff == 0)
+        {
+          if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          {
+            break;
+          }
+        }
+        else if(diff < 0)
+        {
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        else
+        {
+          pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+      }
+      slot -> level = level;
+      slot -> msg.swap(msg);
+      slot -> sequence.store(pos + 1, std::memory_order_release);
+      if(sleeping.load(std::memory_order_relaxed))
+      {
+        wake.notify_one();
+      }
+    }
+
+    void flush()
+    {
+      while(written.load(std::memory_order_acquire) != enqueue_pos.load(std::memory_order_acquire))
+      {
+        wake.notify_one();
+        std::this_thread::yield();
+      }
+    }
+
+  private:
+    bool pop(std::string &msg)
+    {
+      slot_t *slot = &slots[dequeue_pos % queue_size];
+      size_t sequence = slot -> sequence.load(std::memory_order_acquire);
+      if(sequence != dequeue_pos + 1)
+      {
+        return false;
+      }
+      msg.swap(slot -> msg);
+      slot -> msg.clear();
+      slot -> sequence.store(dequeue_pos + queue_size, std::memory_order_release);
+      dequeue_pos++;
+      return true;
+    }
+
+    void run()
+    {
+      std::string msg;
+      while(true)
+      {
+        bool wrote = false;
+        while(pop(msg))
+        {
+          std::cout << msg << '\n';
+          wrote = true;
+          written.store(dequeue_pos, std::memory_order_release);
+        }
+        size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if(lost)
+        {
+          std::cout << "scppr log queue full, dropped " << lost << " messages\n";
+          wrote = true;
+        }
+        if(wrote)
+        {
+          std::cout << std::flush;
+          continue;
+        }
+        if(!running.load())
+        {
+          break;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        sleeping.store(true);
+        wake.wait_for(lock, std::chrono::milliseconds(10));
+        sleeping.store(false);
+      }
+    }
+
+    slot_t slots[queue_size];
+    std::atomic<size_t> enqueue_pos{0};
+    size_t dequeue_pos = 0;
+    std::atomic<size_t> written{0};
+    std::atomic<size_t> dropped{0};
+    std::atomic<bool> running{true};
+    std::atomic<bool> sleeping{false};
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::thread writer;
+  };
+
+  sink_t &sink()
+  {
+    static sink_t instance;
+    return instance;
+  }
+}
+
+void scppr::set_log_level(log_level_t level)
+{
+  _log_level.store(level, std::memory_order_relaxed);
+}
+
+scppr::log_level_t scppr::get_log_level()
+{
+  return (log_level_t)_log_level.load(std::memory_order_relaxed);
+}
+
+void scppr::log_push(log_level_t level, std::string msg)
+{
+  sink().push(level, msg);
+}
+
+void scppr::log_flush()
+{
+  sink().flush();
+}
+
+void scppr::log_fatal(std::string msg)
+{
+  sink().flush();
+  std::cout << msg << std::endl << std::flush;
+}
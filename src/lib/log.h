@@ -1,11 +1,91 @@
 #ifndef SCPPR_LIB_LOG_H
 #define SCPPR_LIB_LOG_H
 
-#include <iostream>
+#include <atomic>
 #include <string>
 #include <stdexcept>
 
-#define scppr_ASSERT(value, fail_msg) if(!value){std::cout << fail_msg << std::endl << std::flush; throw std::runtime_error(fail_msg);}
-#define scppr_LOG(msg) std::cout << msg << std::endl << std::flush;
+#define SCPPR_LOG_LEVEL_TRACE 0
+#define SCPPR_LOG_LEVEL_DEBUG 1
+#define SCPPR_LOG_LEVEL_INFO 2
+#define SCPPR_LOG_LEVEL_WARN 3
+#define SCPPR_LOG_LEVEL_ERROR 4
+#define SCPPR_LOG_LEVEL_OFF 5
+
+// lowest level compiled in, anything below it costs nothing at runtime
+#ifndef SCPPR_LOG_LEVEL
+#ifdef NDEBUG
+#define SCPPR_LOG_LEVEL SCPPR_LOG_LEVEL_DEBUG
+#else
+#define SCPPR_LOG_LEVEL SCPPR_LOG_LEVEL_TRACE
+#endif
+#endif
+
+namespace scppr
+{
+  enum log_level_t
+  {
+    log_trace = SCPPR_LOG_LEVEL_TRACE,
+    log_debug = SCPPR_LOG_LEVEL_DEBUG,
+    log_info = SCPPR_LOG_LEVEL_INFO,
+    log_warn = SCPPR_LOG_LEVEL_WARN,
+    log_error = SCPPR_LOG_LEVEL_ERROR,
+    log_off = SCPPR_LOG_LEVEL_OFF
+  };
+
+  extern std::atomic<int> _log_level;
+
+  // runtime filter, defaults to log_info
+  void set_log_level(log_level_t level);
+  log_level_t get_log_level();
+
+  inline bool log_enabled(log_level_t level)
+  {
+    return level >= _log_level.load(std::memory_order_relaxed);
+  }
+
+  // queues the message for the background writer, never blocks
+  // messages are dropped (and counted) when the queue is full
+  void log_push(log_level_t level, std::string msg);
+  // blocks until every queued message has been written
+  void log_flush();
+  // flushes the queue and writes the message synchronously, used by asserts
+  void log_fatal(std::string msg);
+}
+
+#define scppr_LOG_AT(level, msg) do { if(::scppr::log_enabled(level)) { ::scppr::log_push(level, std::string(msg)); } } while(0)
+
+#if SCPPR_LOG_LEVEL <= SCPPR_LOG_LEVEL_TRACE
+#define scppr_TRACE(msg) scppr_LOG_AT(::scppr::log_trace, msg)
+#else
+#define scppr_TRACE(msg) do {} while(0)
+#endif
+
+#if SCPPR_LOG_LEVEL <= SCPPR_LOG_LEVEL_DEBUG
+#define scppr_DEBUG(msg) scppr_LOG_AT(::scppr::log_debug, msg)
+#else
+#define scppr_DEBUG(msg) do {} while(0)
+#endif
+
+#if SCPPR_LOG_LEVEL <= SCPPR_LOG_LEVEL_INFO
+#define scppr_INFO(msg) scppr_LOG_AT(::scppr::log_info, msg)
+#else
+#define scppr_INFO(msg) do {} while(0)
+#endif
+
+#if SCPPR_LOG_LEVEL <= SCPPR_LOG_LEVEL_WARN
+#define scppr_WARN(msg) scppr_LOG_AT(::scppr::log_warn, msg)
+#else
+#define scppr_WARN(msg) do {} while(0)
+#endif
+
+#if SCPPR_LOG_LEVEL <= SCPPR_LOG_LEVEL_ERROR
+#define scppr_ERROR(msg) scppr_LOG_AT(::scppr::log_error, msg)
+#else
+#define scppr_ERROR(msg) do {} while(0)
+#endif
+
+#define scppr_LOG(msg) scppr_INFO(msg)
+#define scppr_ASSERT(value, fail_msg) if(!(value)){::scppr::log_fatal(std::string(fail_msg)); throw std::runtime_error(fail_msg);}
 
 #endif // SCPPR_LIB_LOG_H
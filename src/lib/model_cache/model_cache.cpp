@@ -0,0 +1,408 @@
+#include "lib/model_cache/model_cache.h"
+#include "lib/log.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#if defined(__unix__) || defined(__APPLE__)
+#define SCPPR_MODEL_CACHE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <process.h>
+#endif
+
+namespace
+{
+  const char magic[8] = {'S', 'C', 'P', 'P', 'R', 'M', 'C', 0};
+  // written as a number and read back, a mismatch means the file comes from a machine of other endianness
+  const uint32_t byte_order = 0x01020304;
+  const size_t data_alignment = 16;
+
+  struct header_t
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t vertex_size;
+    uint32_t import_flags;
+    int64_t source_mtime;
+    uint64_t source_size;
+    uint32_t material_count;
+    uint32_t mesh_count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    // the canonical source path is the first string
+    uint32_t source_length;
+    uint32_t options;
+  };
+
+  struct material_entry_t
+  {
+    uint64_t diffuse_offset;
+    uint32_t diffuse_length;
+    uint32_t specular_length;
+    uint64_t specular_offset;
+  };
+
+  struct mesh_entry_t
+  {
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t material;
+    float bounds[10];
+    uint32_t lod_count;
+    scppr::lod_t lods[scppr::SCPPR_LOD_LEVELS];
+  };
+
+  std::atomic<bool> enabled(true);
+  // tells apart the temporary files of writers in the same process
+  std::atomic<uint64_t> next_temporary(0);
+  std::mutex directory_mutex;
+  std::string directory;
+
+  size_t align(size_t value)
+  {
+    return (value + data_alignment - 1) / data_alignment * data_alignment;
+  }
+
+  bool source_stamp(const std::string &source, int64_t &mtime, uint64_t &size)
+  {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(source, error);
+    if(error)
+    {
+      return false;
+    }
+    size = std::filesystem::file_size(source, error);
+    if(error)
+    {
+      return false;
+    }
+    mtime = time.time_since_epoch().count();
+    return true;
+  }
+
+  uint64_t process_id()
+  {
+#if defined(SCPPR_MODEL_CACHE_MMAP)
+    return getpid();
+#elif defined(_WIN32)
+    return _getpid();
+#else
+    return 0;
+#endif
+  }
+
+  std::string canonical(const std::string &path)
+  {
+    std::error_code error;
+    std::string result = std::filesystem::weakly_canonical(path, error).string();
+    return error ? path : result;
+  }
+}
+
+scppr::model_cache_t::~model_cache_t()
+{
+  close();
+}
+
+bool scppr::model_cache_t::open(const std::string &source, uint32_t import_flags, uint32_t options, size_t vertex_size)
+{
+  close();
+  materials.clear();
+  meshes.clear();
+  if(!enabled)
+  {
+    return false;
+  }
+  int64_t mtime;
+  uint64_t size;
+  if(!source_stamp(source, mtime, size))
+  {
+    return false;
+  }
+  std::string path = model_cache_path(source);
+#ifdef SCPPR_MODEL_CACHE_MMAP
+  int file = ::open(path.c_str(), O_RDONLY);
+  if(file < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if(fstat(file, &info) || (size_t)info.st_size < sizeof(header_t))
+  {
+    ::close(file);
+    return false;
+  }
+  mapping_size = info.st_size;
+  mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, file, 0);
+  ::close(file);
+  if(mapping == MAP_FAILED)
+  {
+    mapping = NULL;
+    return false;
+  }
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if(!file.is_open())
+  {
+    return false;
+  }
+  std::streamoff length = file.tellg();
+  if(length < (std::streamoff)sizeof(header_t))
+  {
+    return false;
+  }
+  contents.resize(length);
+  file.seekg(0);
+  if(!file.read(contents.data(), length))
+  {
+    contents.clear();
+    return false;
+  }
+  mapping = contents.data();
+  mapping_size = length;
+#endif
+
+  const char *base = (const char *)mapping;
+  const header_t *header = (const header_t *)base;
+  std::string source_path = canonical(source);
+  bool valid = !memcmp(header -> magic, magic, sizeof(magic))
+    && header -> version == SCPPR_MODEL_CACHE_VERSION
+    && header -> byte_order == byte_order
+    && header -> vertex_size == vertex_size
+    && header -> import_flags == import_flags
+    && header -> options == options
+    && header -> source_mtime == mtime
+    && header -> source_size == size
+    && header -> strings_offset + header -> strings_size <= mapping_size
+    && header -> source_length <= header -> strings_size
+    && source_path == std::string(base + header -> strings_offset, header -> source_length);
+  size_t tables = sizeof(header_t) + header -> material_count * sizeof(material_entry_t) + header -> mesh_count * sizeof(mesh_entry_t);
+  if(!valid || tables > mapping_size)
+  {
+    scppr_DEBUG("model cache [" + path + "] is stale");
+    close();
+    return false;
+  }
+
+  // every offset is checked against the file before anything points into it
+  auto string_at = [&](uint64_t offset, uint32_t length, std::string &out)
+  {
+    if(offset + length > header -> strings_size)
+    {
+      return false;
+    }
+    out.assign(base + header -> strings_offset + offset, length);
+    return true;
+  };
+  const material_entry_t *material_entries = (const material_entry_t *)(base + sizeof(header_t));
+  for(uint32_t i = 0; i < header -> material_count; i++)
+  {
+    cached_material_t material;
+    if(!string_at(material_entries[i].diffuse_offset, material_entries[i].diffuse_length, material.diffuse) || !string_at(material_entries[i].specular_offset, material_entries[i].specular_length, material.specular))
+    {
+      valid = false;
+      break;
+    }
+    materials.push_back(material);
+  }
+  const mesh_entry_t *mesh_entries = (const mesh_entry_t *)(material_entries + header -> material_count);
+  for(uint32_t i = 0; valid && i < header -> mesh_count; i++)
+  {
+    const mesh_entry_t &entry = mesh_entries[i];
+    if(entry.vertex_offset + (uint64_t)entry.vertex_count * vertex_size > mapping_size || entry.index_offset + (uint64_t)entry.index_count * sizeof(uint32_t) > mapping_size || entry.material >= header -> material_count || !entry.lod_count || entry.lod_count > SCPPR_LOD_LEVELS)
+    {
+      valid = false;
+      break;
+    }
+    for(uint32_t level = 0; level < entry.lod_count; level++)
+    {
+      valid = valid && (uint64_t)entry.lods[level].first_index + entry.lods[level].index_count <= entry.index_count;
+    }
+    if(!valid)
+    {
+      break;
+    }
+    cached_mesh_t mesh;
+    mesh.vertices = base + entry.vertex_offset;
+    mesh.vertex_count = entry.vertex_count;
+    mesh.indices = (const uint32_t *)(base + entry.index_offset);
+    mesh.index_count = entry.index_count;
+    mesh.material = entry.material;
+    mesh.bounds.min = glm::vec3(entry.bounds[0], entry.bounds[1], entry.bounds[2]);
+    mesh.bounds.max = glm::vec3(entry.bounds[3], entry.bounds[4], entry.bounds[5]);
+    mesh.bounds.center = glm::vec3(entry.bounds[6], entry.bounds[7], entry.bounds[8]);
+    mesh.bounds.radius = entry.bounds[9];
+    mesh.lods.assign(entry.lods, entry.lods + entry.lod_count);
+    meshes.push_back(mesh);
+  }
+  if(!valid)
+  {
+    scppr_WARN("model cache [" + path + "] is damaged");
+    materials.clear();
+    meshes.clear();
+    close();
+    return false;
+  }
+  scppr_DEBUG("using model cache [" + path + "]");
+  return true;
+}
+
+void scppr::model_cache_t::close()
+{
+  if(mapping)
+  {
+#ifdef SCPPR_MODEL_CACHE_MMAP
+    munmap(mapping, mapping_size);
+#else
+    std::vector<char>().swap(contents);
+#endif
+    mapping = NULL;
+    mapping_size = 0;
+  }
+}
+
+void scppr::write_model_cache(const std::string &source, uint32_t import_flags, uint32_t options, size_t vertex_size, const std::vector<cached_material_t> &materials, const std::vector<cached_mesh_t> &meshes)
+{
+  if(!enabled)
+  {
+    return;
+  }
+  header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = SCPPR_MODEL_CACHE_VERSION;
+  header.byte_order = byte_order;
+  header.vertex_size = vertex_size;
+  header.import_flags = import_flags;
+  header.options = options;
+  if(!source_stamp(source, header.source_mtime, header.source_size))
+  {
+    return;
+  }
+  header.material_count = materials.size();
+  header.mesh_count = meshes.size();
+
+  std::string strings = canonical(source);
+  header.source_length = strings.size();
+  std::vector<material_entry_t> material_entries(materials.size());
+  for(size_t i = 0; i < materials.size(); i++)
+  {
+    material_entries[i].diffuse_offset = strings.size();
+    material_entries[i].diffuse_length = materials[i].diffuse.size();
+    strings += materials[i].diffuse;
+    material_entries[i].specular_offset = strings.size();
+    material_entries[i].specular_length = materials[i].specular.size();
+    strings += materials[i].specular;
+  }
+  header.strings_offset = sizeof(header_t) + materials.size() * sizeof(material_entry_t) + meshes.size() * sizeof(mesh_entry_t);
+  header.strings_size = strings.size();
+
+  std::vector<mesh_entry_t> mesh_entries(meshes.size());
+  size_t offset = align(header.strings_offset + header.strings_size);
+  for(size_t i = 0; i < meshes.size(); i++)
+  {
+    mesh_entry_t &entry = mesh_entries[i];
+    const cached_mesh_t &mesh = meshes[i];
+    entry.vertex_offset = offset;
+    entry.vertex_count = mesh.vertex_count;
+    offset = align(offset + (size_t)mesh.vertex_count * vertex_size);
+    entry.index_offset = offset;
+    entry.index_count = mesh.index_count;
+    offset = align(offset + (size_t)mesh.index_count * sizeof(uint32_t));
+    entry.material = mesh.material;
+    float bounds[10] = {mesh.bounds.min.x, mesh.bounds.min.y, mesh.bounds.min.z, mesh.bounds.max.x, mesh.bounds.max.y, mesh.bounds.max.z, mesh.bounds.center.x, mesh.bounds.center.y, mesh.bounds.center.z, mesh.bounds.radius};
+    memcpy(entry.bounds, bounds, sizeof(bounds));
+    // meshes written without levels are their own full level
+    std::vector<lod_t> lods = mesh.lods;
+    if(lods.empty())
+    {
+      lods.push_back({0, mesh.index_count, 0});
+    }
+    entry.lod_count = std::min<size_t>(lods.size(), SCPPR_LOD_LEVELS);
+    std::copy_n(lods.begin(), entry.lod_count, entry.lods);
+  }
+
+  // written aside and renamed so readers never see half a file
+  std::string path = model_cache_path(source);
+  std::string temporary = path + ".tmp" + std::to_string(process_id()) + "_" + std::to_string(next_temporary++);
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if(!file.is_open())
+    {
+      scppr_DEBUG("cannot write model cache [" + path + "]");
+      return;
+    }
+    static const char zeros[data_alignment] = {0};
+    auto pad_to = [&](size_t position)
+    {
+      size_t current = file.tellp();
+      file.write(zeros, position - current);
+    };
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)material_entries.data(), material_entries.size() * sizeof(material_entry_t));
+    file.write((const char *)mesh_entries.data(), mesh_entries.size() * sizeof(mesh_entry_t));
+    file.write(strings.data(), strings.size());
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+      pad_to(mesh_entries[i].vertex_offset);
+      file.write((const char *)meshes[i].vertices, (size_t)meshes[i].vertex_count * vertex_size);
+      pad_to(mesh_entries[i].index_offset);
+      file.write((const char *)meshes[i].indices, (size_t)meshes[i].index_count * sizeof(uint32_t));
+    }
+    if(!file.good())
+    {
+      scppr_WARN("failed writing model cache [" + path + "]");
+      file.close();
+      std::remove(temporary.c_str());
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if(error)
+  {
+    scppr_WARN("failed writing model cache [" + path + "]");
+    std::remove(temporary.c_str());
+    return;
+  }
+  scppr_DEBUG("wrote model cache [" + path + "]");
+}
+
+std::string scppr::model_cache_path(const std::string &source)
+{
+  std::lock_guard<std::mutex> lock(directory_mutex);
+  if(directory.empty())
+  {
+    return source + ".scppr_cache";
+  }
+  // flattened canonical path, so equal file names from different folders do not collide
+  std::string name = canonical(source);
+  for(auto &c : name)
+  {
+    if(c == '/' || c == '\\' || c == ':')
+    {
+      c = '_';
+    }
+  }
+  return directory + "/" + name + ".scppr_cache";
+}
+
+void scppr::set_model_cache_directory(std::string directory)
+{
+  std::lock_guard<std::mutex> lock(directory_mutex);
+  ::directory = directory;
+}
+
+void scppr::set_model_cache_enabled(bool enabled)
+{
+  ::enabled = enabled;
+}
@@ -0,0 +1,69 @@
+#ifndef SCPPR_LIB_MODEL_CACHE_MODEL_CACHE_H
+#define SCPPR_LIB_MODEL_CACHE_MODEL_CACHE_H
+
+#include "lib/cull/cull.h"
+#include "lib/lod/lod.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace scppr
+{
+  // bump whenever the layout of the file or of what it describes changes
+  static const uint32_t SCPPR_MODEL_CACHE_VERSION = 3;
+
+  // converted models are written to one binary file per source, valid for the source size, mtime, import flags and options
+  // options are whatever else changes the converted data, chosen by the caller
+  // the file is mapped and meshes point straight into it, vertices are stored in their gpu layout
+  // where there is no mmap it is read into memory whole instead
+  //
+  // header, material table, mesh table, strings, then 16 byte aligned vertex and index data
+
+  struct cached_material_t
+  {
+    // canonical paths of the textures
+    std::string diffuse;
+    std::string specular;
+  };
+
+  struct cached_mesh_t
+  {
+    const void *vertices;
+    uint32_t vertex_count;
+    // every level, see build_lods
+    const uint32_t *indices;
+    uint32_t index_count;
+    uint32_t material;
+    bounds_t bounds;
+    std::vector<lod_t> lods;
+  };
+
+  // read only view of a cache file, mesh data stays valid while it lives
+  class model_cache_t
+  {
+  public:
+    ~model_cache_t();
+    // false when the source has no usable cache file
+    bool open(const std::string &source, uint32_t import_flags, uint32_t options, size_t vertex_size);
+    std::vector<cached_material_t> materials;
+    std::vector<cached_mesh_t> meshes;
+  private:
+    void close();
+    void *mapping = NULL;
+    size_t mapping_size = 0;
+    // the file read into memory where it cannot be mapped, mapping points into it then
+    std::vector<char> contents;
+  };
+
+  // failures are logged and otherwise ignored, the cache is only ever an optimisation
+  void write_model_cache(const std::string &source, uint32_t import_flags, uint32_t options, size_t vertex_size, const std::vector<cached_material_t> &materials, const std::vector<cached_mesh_t> &meshes);
+  // where the cache of source lives, next to it unless a cache directory was set
+  std::string model_cache_path(const std::string &source);
+  // empty puts cache files next to their sources
+  void set_model_cache_directory(std::string directory);
+  // turns reading and writing cache files on or off, on by default
+  void set_model_cache_enabled(bool enabled);
+}
+
+#endif // SCPPR_LIB_MODEL_CACHE_MODEL_CACHE_H
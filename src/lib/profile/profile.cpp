@@ -0,0 +1,264 @@
+#include "lib/profile/profile.h"
+#include "lib/log.h"
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+namespace
+{
+  struct query_t
+  {
+    GLuint begin = 0;
+    GLuint end = 0;
+    const char *name;
+    uint64_t frame;
+    uint32_t depth;
+    bool ended = false;
+  };
+
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+  std::mutex zones_mutex;
+  std::deque<scppr::profile_zone_t> zones;
+  std::atomic<uint64_t> frame(0);
+  std::atomic<uint32_t> next_thread(1);
+  thread_local uint32_t thread_index = 0;
+  thread_local uint32_t thread_depth = 0;
+
+  // gl thread only from here on
+  std::vector<query_t> queries;
+  // next slot to begin and slots begun behind it, collected in the order they began
+  size_t query_head = 0;
+  size_t queries_in_flight = 0;
+  uint32_t gpu_depth = 0;
+  // cpu microseconds minus gpu microseconds, taken once the profiler is enabled
+  double gpu_offset = 0;
+  bool calibrated = false;
+
+  double since_epoch(std::chrono::steady_clock::time_point time)
+  {
+    return std::chrono::duration<double, std::micro>(time - epoch).count();
+  }
+
+  void add_zone(const scppr::profile_zone_t &zone)
+  {
+    std::lock_guard<std::mutex> lock(zones_mutex);
+    zones.push_back(zone);
+  }
+
+  std::string escape(const char *name)
+  {
+    std::string result;
+    for(const char *c = name; *c; c++)
+    {
+      if(*c == '"' || *c == '\\')
+      {
+        result += '\\';
+      }
+      if((unsigned char)*c >= 0x20)
+      {
+        result += *c;
+      }
+    }
+    return result;
+  }
+}
+
+std::atomic<bool> scppr::_profiling_enabled(false);
+
+void scppr::set_profiling_enabled(bool enabled)
+{
+#ifndef SCPPR_PROFILE
+  if(enabled)
+  {
+    scppr_WARN("scppr was built without SCPPR_PROFILE, no zones will be recorded");
+  }
+#endif
+  _profiling_enabled = enabled;
+}
+
+void scppr::profile_frame()
+{
+  if(!profiling_enabled())
+  {
+    // results still out would land on the next calibration's clock
+    calibrated = false;
+    queries_in_flight = 0;
+    return;
+  }
+  uint64_t current = ++frame;
+  if(!calibrated)
+  {
+    GLint64 gpu_now;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    gpu_offset = since_epoch(std::chrono::steady_clock::now()) - gpu_now / 1000.0;
+    calibrated = true;
+  }
+
+  // results arrive in order, the first one missing ends the collection without waiting for it
+  while(queries_in_flight)
+  {
+    query_t &query = queries[(query_head + queries.size() - queries_in_flight) % queries.size()];
+    if(!query.ended)
+    {
+      break;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available)
+    {
+      break;
+    }
+    GLuint64 begin;
+    GLuint64 end;
+    glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &end);
+    add_zone({query.name, query.frame, 0, query.depth, begin / 1000.0 + gpu_offset, (end - begin) / 1000.0});
+    query.ended = false;
+    queries_in_flight--;
+  }
+
+  std::lock_guard<std::mutex> lock(zones_mutex);
+  while(!zones.empty() && zones.front().frame + SCPPR_PROFILE_FRAMES < current)
+  {
+    zones.pop_front();
+  }
+}
+
+std::vector<scppr::profile_zone_t> scppr::profile_zones()
+{
+  std::lock_guard<std::mutex> lock(zones_mutex);
+  return std::vector<profile_zone_t>(zones.begin(), zones.end());
+}
+
+void scppr::clear_profile()
+{
+  std::lock_guard<std::mutex> lock(zones_mutex);
+  zones.clear();
+}
+
+bool scppr::write_chrome_trace(const std::string &path)
+{
+  std::vector<profile_zone_t> copy = profile_zones();
+  std::ofstream file(path, std::ios::trunc);
+  if(!file.is_open())
+  {
+    scppr_WARN("cannot write chrome trace [" + path + "]");
+    return false;
+  }
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  std::set<uint32_t> threads;
+  for(auto &zone : copy)
+  {
+    threads.insert(zone.thread);
+  }
+  bool first = true;
+  for(auto thread : threads)
+  {
+    std::string name = thread ? "cpu " + std::to_string(thread) : "gpu";
+    file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"" << name << "\"}}";
+    first = false;
+  }
+  file.precision(3);
+  file << std::fixed;
+  for(auto &zone : copy)
+  {
+    file << (first ? "" : ",\n") << "{\"name\":\"" << escape(zone.name) << "\",\"cat\":\"" << (zone.thread ? "cpu" : "gpu") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << zone.thread
+      << ",\"ts\":" << zone.start << ",\"dur\":" << zone.duration << ",\"args\":{\"frame\":" << zone.frame << "}}";
+    first = false;
+  }
+  file << "\n]}\n";
+  if(!file.good())
+  {
+    scppr_WARN("failed writing chrome trace [" + path + "]");
+    return false;
+  }
+  scppr_DEBUG("wrote " + std::to_string(copy.size()) + " zones to chrome trace [" + path + "]");
+  return true;
+}
+
+void scppr::profile_shutdown()
+{
+  for(auto &query : queries)
+  {
+    glDeleteQueries(1, &query.begin);
+    glDeleteQueries(1, &query.end);
+  }
+  queries.clear();
+  query_head = 0;
+  queries_in_flight = 0;
+  gpu_depth = 0;
+  calibrated = false;
+}
+
+scppr::profile_scope_t::profile_scope_t(const char *name)
+{
+  active = profiling_enabled();
+  if(!active)
+  {
+    return;
+  }
+  this -> name = name;
+  if(!thread_index)
+  {
+    thread_index = next_thread++;
+  }
+  thread_depth++;
+  start = std::chrono::steady_clock::now();
+}
+
+scppr::profile_scope_t::~profile_scope_t()
+{
+  if(!active)
+  {
+    return;
+  }
+  auto end = std::chrono::steady_clock::now();
+  thread_depth--;
+  add_zone({name, frame.load(std::memory_order_relaxed), thread_index, thread_depth, since_epoch(start), std::chrono::duration<double, std::micro>(end - start).count()});
+}
+
+scppr::gpu_profile_scope_t::gpu_profile_scope_t(const char *name)
+{
+  slot = -1;
+  // zones before the first profile_frame would have no clock to go by
+  if(!profiling_enabled() || !calibrated)
+  {
+    return;
+  }
+  if(queries.empty())
+  {
+    queries.resize(SCPPR_PROFILE_GPU_QUERIES);
+    for(auto &query : queries)
+    {
+      glGenQueries(1, &query.begin);
+      glGenQueries(1, &query.end);
+    }
+  }
+  if(queries_in_flight == queries.size())
+  {
+    scppr_TRACE("every gpu timer query is in flight, skipping zone");
+    return;
+  }
+  slot = query_head;
+  query_head = (query_head + 1) % queries.size();
+  queries_in_flight++;
+  query_t &query = queries[slot];
+  query.name = name;
+  query.frame = frame.load(std::memory_order_relaxed);
+  query.depth = gpu_depth++;
+  query.ended = false;
+  glQueryCounter(query.begin, GL_TIMESTAMP);
+}
+
+scppr::gpu_profile_scope_t::~gpu_profile_scope_t()
+{
+  if(slot < 0)
+  {
+    return;
+  }
+  glQueryCounter(queries[slot].end, GL_TIMESTAMP);
+  queries[slot].ended = true;
+  gpu_depth--;
+}
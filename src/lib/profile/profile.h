@@ -0,0 +1,88 @@
+#ifndef SCPPR_LIB_PROFILE_PROFILE_H
+#define SCPPR_LIB_PROFILE_PROFILE_H
+
+#include "lib/glad.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace scppr
+{
+  // zones are recorded only when built with SCPPR_PROFILE and enabled with set_profiling_enabled
+  // without SCPPR_PROFILE the zone macros compile to nothing
+  // frames of zones kept for profile_zones and write_chrome_trace
+  static const uint64_t SCPPR_PROFILE_FRAMES = 240;
+  // timestamp query pairs in flight, gpu zones are skipped while all are waiting for results
+  static const size_t SCPPR_PROFILE_GPU_QUERIES = 256;
+
+  struct profile_zone_t
+  {
+    // must outlive the profiler, string literals in practice
+    const char *name;
+    uint64_t frame;
+    // 0 for the gpu, threads count up from 1 in the order they first recorded a zone
+    uint32_t thread;
+    // zones open around this one on the same thread
+    uint32_t depth;
+    // microseconds since the profiler started, gpu times are moved onto the cpu clock
+    double start;
+    double duration;
+  };
+
+  extern std::atomic<bool> _profiling_enabled;
+
+  void set_profiling_enabled(bool enabled);
+  inline bool profiling_enabled()
+  {
+    return _profiling_enabled.load(std::memory_order_relaxed);
+  }
+  // gl thread, once a frame before its zones, collects the gpu results that arrived
+  void profile_frame();
+  // copy of the zones of the last SCPPR_PROFILE_FRAMES frames, oldest first, gpu zones arrive a few frames late
+  std::vector<profile_zone_t> profile_zones();
+  void clear_profile();
+  // chrome trace event json, opens in chrome://tracing or perfetto
+  bool write_chrome_trace(const std::string &path);
+  // gl thread, deletes the query objects while the context is still there
+  void profile_shutdown();
+
+  // cpu zone from construction to destruction
+  class profile_scope_t
+  {
+  public:
+    profile_scope_t(const char *name);
+    ~profile_scope_t();
+  private:
+    const char *name;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  // gpu zone around the commands issued from construction to destruction, gl thread only
+  class gpu_profile_scope_t
+  {
+  public:
+    gpu_profile_scope_t(const char *name);
+    ~gpu_profile_scope_t();
+  private:
+    // slot in the query ring, -1 when not recording
+    int slot;
+  };
+}
+
+#define scppr_PROFILE_JOIN2(a, b) a##b
+#define scppr_PROFILE_JOIN(a, b) scppr_PROFILE_JOIN2(a, b)
+
+#ifdef SCPPR_PROFILE
+#define scppr_PROFILE_ZONE(name) ::scppr::profile_scope_t scppr_PROFILE_JOIN(scppr_profile_zone_, __LINE__)(name)
+#define scppr_PROFILE_GPU_ZONE(name) ::scppr::gpu_profile_scope_t scppr_PROFILE_JOIN(scppr_profile_gpu_zone_, __LINE__)(name)
+#define scppr_PROFILE_FRAME() ::scppr::profile_frame()
+#else
+#define scppr_PROFILE_ZONE(name) do {} while(0)
+#define scppr_PROFILE_GPU_ZONE(name) do {} while(0)
+#define scppr_PROFILE_FRAME() do {} while(0)
+#endif
+
+#endif // SCPPR_LIB_PROFILE_PROFILE_H
@@ -0,0 +1,154 @@
+#include "lib/registry/registry.h"
+#include "lib/scppr.h"
+#include "lib/transform/transform.h"
+
+// objects per transform job
+static const size_t SCPPR_TRANSFORM_GRAIN = 4096;
+
+scppr::registry_t::~registry_t()
+{
+  for(auto obj : objects)
+  {
+    obj -> registry = NULL;
+    obj -> handle = SCPPR_NO_HANDLE;
+  }
+}
+
+void scppr::registry_t::add(object_t *obj)
+{
+  if(contains(obj))
+  {
+    return;
+  }
+  uint32_t handle;
+  if(free_handles.empty())
+  {
+    handle = handle_to_index.size();
+    handle_to_index.push_back(0);
+    dirty.push_back(0);
+  }
+  else
+  {
+    handle = free_handles.back();
+    free_handles.pop_back();
+  }
+  handle_to_index[handle] = objects.size();
+  index_to_handle.push_back(handle);
+  obj -> registry = this;
+  obj -> handle = handle;
+
+  objects.push_back(obj);
+  positions.push_back(obj -> get_position());
+  rotations.push_back(obj -> get_rotation());
+  scales.push_back(obj -> get_scale());
+  transforms.push_back(instance_t());
+  mark_dirty(handle);
+  mark_placement(handle);
+}
+
+void scppr::registry_t::remove(object_t *obj)
+{
+  if(!contains(obj))
+  {
+    return;
+  }
+  uint32_t index = handle_to_index[obj -> handle];
+  uint32_t last = objects.size() - 1;
+  if(index != last)
+  {
+    objects[index] = objects[last];
+    positions[index] = positions[last];
+    rotations[index] = rotations[last];
+    scales[index] = scales[last];
+    transforms[index] = transforms[last];
+    index_to_handle[index] = index_to_handle[last];
+    handle_to_index[index_to_handle[index]] = index;
+  }
+  objects.pop_back();
+  positions.pop_back();
+  rotations.pop_back();
+  scales.pop_back();
+  transforms.pop_back();
+  index_to_handle.pop_back();
+  // a pending dirty entry for this handle is skipped once the flag is cleared
+  dirty[obj -> handle] = 0;
+  free_handles.push_back(obj -> handle);
+  mark_placement(obj -> handle);
+  obj -> registry = NULL;
+  obj -> handle = SCPPR_NO_HANDLE;
+}
+
+bool scppr::registry_t::contains(object_t *obj)
+{
+  uint32_t handle = obj -> handle;
+  return obj -> registry == this && handle < handle_to_index.size() && handle_to_index[handle] < objects.size() && objects[handle_to_index[handle]] == obj;
+}
+
+bool scppr::registry_t::alive(uint32_t handle)
+{
+  return handle < handle_to_index.size() && handle_to_index[handle] < objects.size() && index_to_handle[handle_to_index[handle]] == handle;
+}
+
+void scppr::registry_t::mark_placement(uint32_t handle)
+{
+  placements.push_back(handle);
+}
+
+void scppr::registry_t::take_placements(std::vector<uint32_t> &handles)
+{
+  handles.swap(placements);
+  placements.clear();
+}
+
+uint32_t scppr::registry_t::size()
+{
+  return objects.size();
+}
+
+uint32_t scppr::registry_t::index_of(uint32_t handle)
+{
+  return handle_to_index[handle];
+}
+
+uint32_t scppr::registry_t::handle_of(uint32_t index)
+{
+  return index_to_handle[index];
+}
+
+void scppr::registry_t::mark_dirty(uint32_t handle)
+{
+  if(!dirty[handle])
+  {
+    dirty[handle] = 1;
+    dirty_handles.push_back(handle);
+  }
+}
+
+void scppr::registry_t::update_transforms(job_system_t &jobs)
+{
+  dirty_indices.clear();
+  for(uint32_t handle : dirty_handles)
+  {
+    if(!dirty[handle])
+    {
+      continue;
+    }
+    dirty[handle] = 0;
+    uint32_t i = handle_to_index[handle];
+    object_t *obj = objects[i];
+    positions[i] = obj -> get_position();
+    rotations[i] = obj -> get_rotation();
+    scales[i] = obj -> get_scale();
+    dirty_indices.push_back(i);
+  }
+  dirty_handles.clear();
+  jobs.parallel_for(dirty_indices.size(), SCPPR_TRANSFORM_GRAIN, [this](size_t begin, size_t end)
+  {
+    compute_transforms(dirty_indices.data() + begin, end - begin, positions.data(), rotations.data(), scales.data(), transforms.data());
+  });
+}
+
+const std::vector<uint32_t> &scppr::registry_t::updated()
+{
+  return dirty_indices;
+}
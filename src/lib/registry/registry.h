@@ -0,0 +1,58 @@
+#ifndef SCPPR_LIB_REGISTRY_REGISTRY_H
+#define SCPPR_LIB_REGISTRY_REGISTRY_H
+
+#include "lib/shader/shader.h"
+#include "lib/job/job.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace scppr
+{
+  class object_t;
+
+  static const uint32_t SCPPR_NO_HANDLE = UINT32_MAX;
+
+  // dense structure of arrays storage for the objects of a scene
+  // index i refers to the same object in every array, removal swaps the last object into the hole
+  // handles are stored on the object and stay valid until it is removed
+  class registry_t
+  {
+  public:
+    // objects still in the registry are let go, so they can outlive it
+    ~registry_t();
+    void add(object_t *obj);
+    void remove(object_t *obj);
+    bool contains(object_t *obj);
+    uint32_t size();
+    uint32_t index_of(uint32_t handle);
+    uint32_t handle_of(uint32_t index);
+    // false once the object behind handle has been removed
+    bool alive(uint32_t handle);
+    // handles whose place in the scene's trees has to be looked at again, added and removed ones among them
+    void mark_placement(uint32_t handle);
+    // hands over the handles marked since the last call, a removed handle may already belong to a new object
+    void take_placements(std::vector<uint32_t> &handles);
+    // called by the object setters, the object is picked up by the next update_transforms
+    void mark_dirty(uint32_t handle);
+    // copies the dirty objects into the dense arrays and rebuilds only their transforms
+    void update_transforms(job_system_t &jobs);
+    // dense indices rebuilt by the last update_transforms
+    const std::vector<uint32_t> &updated();
+    std::vector<object_t *> objects;
+    std::vector<glm::dvec3> positions;
+    std::vector<glm::dvec3> rotations;
+    std::vector<glm::dvec3> scales;
+    std::vector<instance_t> transforms;
+  private:
+    std::vector<uint32_t> handle_to_index;
+    std::vector<uint32_t> index_to_handle;
+    std::vector<uint32_t> free_handles;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> dirty_handles;
+    std::vector<uint32_t> dirty_indices;
+    std::vector<uint32_t> placements;
+  };
+}
+
+#endif // SCPPR_LIB_REGISTRY_REGISTRY_H
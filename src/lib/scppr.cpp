@@ -1,429 +1,2208 @@
 #include "lib/scppr.h"
 #include "lib/shader/shader.h"
 #include "lib/log.h"
+#include "lib/gl/gl.h"
+#include "lib/model_cache/model_cache.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include "lib/texture/stb_image.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <mutex>
 
 bool scppr_initialised = false;
 std::string scppr::_assets_path;
+std::atomic<uint32_t> scppr_next_texture_key(0);
+std::atomic<uint32_t> scppr_next_mesh_key(0);
+// meshes are placed in the shared arenas while this is set
+scppr::geometry_t *scppr_geometry[scppr::vertex_format_count] = {NULL};
+// textures are placed in texture arrays while this is set
+scppr::atlas_t *scppr_atlas = NULL;
+// loaders write decoded pixels straight into this while it is set
+scppr::staging_ring_t *scppr_staging = NULL;
+// model meshes release their cpu side geometry after upload while this is set
+bool scppr_release_geometry = false;
+// imported meshes are reordered while these are set, see SCPPR_OPTIMISE_MESHES
+bool scppr_optimise_meshes = false;
+bool scppr_optimise_overdraw = false;
+// textures handed out by load_texture, by canonical path and by hash of their pixels
+std::map<std::string, scppr::texture_t *> scppr_textures_by_path;
+std::map<uint64_t, scppr::texture_t *> scppr_textures_by_content;
+// loader threads look into the cache to skip decoding files that are shared already
+std::mutex scppr_texture_mutex;
+
+// points the instance attributes of the bound vertex array at the instance buffers, starting at first_instance
+void scppr_instance_attributes(GLuint instance_vbo, GLuint material_vbo, size_t first_instance)
+{
+  size_t offset = first_instance * sizeof(instance_t);
+  scppr::gl_bind_buffer(GL_ARRAY_BUFFER, instance_vbo);
+  for(GLuint i = 0; i < 4; i++)
+  {
+    glVertexAttribPointer(SCPPR_INSTANCE_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, sizeof(instance_t), (void*)(offset + offsetof(instance_t, model) + i * sizeof(glm::vec4)));
+  }
+  for(GLuint i = 0; i < 3; i++)
+  {
+    glVertexAttribPointer(SCPPR_INSTANCE_ATTRIBUTE + 4 + i, 3, GL_FLOAT, GL_FALSE, sizeof(instance_t), (void*)(offset + offsetof(instance_t, normal) + i * sizeof(glm::vec3)));
+  }
+  if(!material_vbo)
+  {
+    return;
+  }
+  offset = first_instance * sizeof(material_instance_t);
+  scppr::gl_bind_buffer(GL_ARRAY_BUFFER, material_vbo);
+  glVertexAttribPointer(SCPPR_MATERIAL_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(material_instance_t), (void*)(offset + offsetof(material_instance_t, diffuse_rect)));
+  glVertexAttribPointer(SCPPR_MATERIAL_ATTRIBUTE + 1, 4, GL_FLOAT, GL_FALSE, sizeof(material_instance_t), (void*)(offset + offsetof(material_instance_t, specular_rect)));
+  glVertexAttribPointer(SCPPR_MATERIAL_ATTRIBUTE + 2, 2, GL_FLOAT, GL_FALSE, sizeof(material_instance_t), (void*)(offset + offsetof(material_instance_t, layers)));
+}
+
+size_t scppr_vertex_size(scppr::vertex_format_t format)
+{
+  return format == scppr::full_vertices ? sizeof(scppr::vertex_t) : sizeof(scppr::packed_vertex_t);
+}
+
+// points attributes 0 - 2 of the bound vertex array at vertices of format in the bound array buffer
+void scppr_vertex_attributes(scppr::vertex_format_t format)
+{
+  if(format == scppr::full_vertices)
+  {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(scppr::vertex_t), (void*)0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(scppr::vertex_t), (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(scppr::vertex_t), (void*)(5 * sizeof(float)));
+  }
+  else
+  {
+    // quantized positions come out in 0 - 1 and half positions as they are, dequantise does the rest
+    if(format == scppr::quantized_vertices)
+    {
+      glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(scppr::packed_vertex_t), (void*)offsetof(scppr::packed_vertex_t, position));
+    }
+    else
+    {
+      glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(scppr::packed_vertex_t), (void*)offsetof(scppr::packed_vertex_t, position));
+    }
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(scppr::packed_vertex_t), (void*)offsetof(scppr::packed_vertex_t, texture_coord));
+    glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(scppr::packed_vertex_t), (void*)offsetof(scppr::packed_vertex_t, normal));
+  }
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+  for(GLuint i = 0; i < SCPPR_INSTANCE_ATTRIBUTE_COUNT; i++)
+  {
+    glEnableVertexAttribArray(SCPPR_INSTANCE_ATTRIBUTE + i);
+    glVertexAttribDivisor(SCPPR_INSTANCE_ATTRIBUTE + i, 1);
+  }
+  if(!scppr_atlas)
+  {
+    return;
+  }
+  for(GLuint i = 0; i < SCPPR_MATERIAL_ATTRIBUTE_COUNT; i++)
+  {
+    glEnableVertexAttribArray(SCPPR_MATERIAL_ATTRIBUTE + i);
+    glVertexAttribDivisor(SCPPR_MATERIAL_ATTRIBUTE + i, 1);
+  }
+}
+
+// arrays can be replaced when they grow, so their name is looked up on every use
+GLuint scppr_texture_name(const scppr::texture_t *texture)
+{
+  return texture -> slot.array ? texture -> slot.array -> id : texture -> t_id;
+}
+
+uint32_t scppr_texture_key(const scppr::texture_t *texture)
+{
+  return texture -> slot.array ? texture -> slot.array -> key_id : texture -> key_id;
+}
+
+// keys are truncated ids, so equal keys still fall back to the state they stand for
+bool scppr_draw_item_order(const scppr::draw_item_t &a, const scppr::draw_item_t &b)
+{
+  if(a.key != b.key)
+  {
+    return a.key < b.key;
+  }
+  if(a.mesh != b.mesh)
+  {
+    return a.mesh < b.mesh;
+  }
+  if(a.lod != b.lod)
+  {
+    return a.lod < b.lod;
+  }
+  if(a.diffuse != b.diffuse)
+  {
+    return a.diffuse < b.diffuse;
+  }
+  return a.specular < b.specular;
+}
+
+bool scppr_same_state(const scppr::draw_item_t &a, const scppr::draw_item_t &b)
+{
+  return a.mesh == b.mesh && a.lod == b.lod && a.diffuse == b.diffuse && a.specular == b.specular;
+}
+
+uint64_t scppr_draw_key(uint32_t program, uint32_t diffuse, uint32_t specular, uint32_t mesh, uint32_t lod, uint32_t depth)
+{
+  uint64_t key = 0;
+  key |= (uint64_t)(program & 0xf) << scppr::SCPPR_KEY_PROGRAM_SHIFT;
+  key |= (uint64_t)(diffuse & 0x1fff) << scppr::SCPPR_KEY_DIFFUSE_SHIFT;
+  key |= (uint64_t)(specular & 0x1fff) << scppr::SCPPR_KEY_SPECULAR_SHIFT;
+  key |= (uint64_t)(mesh & 0x3ffff) << scppr::SCPPR_KEY_MESH_SHIFT;
+  key |= (uint64_t)(lod & 0x3) << scppr::SCPPR_KEY_LOD_SHIFT;
+  key |= depth & ((1 << scppr::SCPPR_KEY_DEPTH_BITS) - 1);
+  return key;
+}
+
+scppr::bounds_t scppr_vertex_bounds(const std::vector<scppr::vertex_t> &vertices)
+{
+  scppr::bounds_t bounds;
+  if(vertices.empty())
+  {
+    return bounds;
+  }
+  bounds.min = vertices[0].position;
+  bounds.max = vertices[0].position;
+  for(auto &vertex : vertices)
+  {
+    bounds.min = glm::min(bounds.min, vertex.position);
+    bounds.max = glm::max(bounds.max, vertex.position);
+  }
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+  for(auto &vertex : vertices)
+  {
+    bounds.radius = std::max(bounds.radius, glm::distance(bounds.center, vertex.position));
+  }
+  return bounds;
+}
+
+// rounds to nearest, values past the half range become infinity
+uint16_t scppr_half(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t mantissa = bits & 0x7fffff;
+  if(((bits >> 23) & 0xff) == 0xff)
+  {
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+  int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+  if(exponent >= 31)
+  {
+    return sign | 0x7c00;
+  }
+  if(exponent <= 0)
+  {
+    if(exponent < -10)
+    {
+      return sign;
+    }
+    // subnormal, the implicit bit becomes part of the mantissa
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    half += (mantissa >> (shift - 1)) & 1;
+    return sign | half;
+  }
+  // a carry out of the mantissa rounds up into the exponent, which is what it should do
+  uint32_t half = (exponent << 10) | (mantissa >> 13);
+  half += (mantissa >> 12) & 1;
+  return sign | half;
+}
+
+// octahedral encoding of a unit vector, x and y of a signed 10:10:10:2 value
+uint32_t scppr_pack_normal(const glm::vec3 &normal)
+{
+  float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+  if(length == 0)
+  {
+    return 0;
+  }
+  float x = normal.x / length;
+  float y = normal.y / length;
+  if(normal.z < 0)
+  {
+    // the lower half folds over the diagonals
+    float folded_x = (1 - std::fabs(y)) * (x >= 0 ? 1 : -1);
+    float folded_y = (1 - std::fabs(x)) * (y >= 0 ? 1 : -1);
+    x = folded_x;
+    y = folded_y;
+  }
+  auto snorm10 = [](float value)
+  {
+    return (uint32_t)(int32_t)std::round(std::min(std::max(value, -1.0f), 1.0f) * 511) & 0x3ff;
+  };
+  return snorm10(x) | snorm10(y) << 10;
+}
+
+// vertices in the layout of a packed format, dequantise is set to the matrix taking positions back to model space
+std::vector<scppr::packed_vertex_t> scppr_pack_vertices(const std::vector<scppr::vertex_t> &vertices, scppr::vertex_format_t format, glm::mat4 &dequantise)
+{
+  scppr::bounds_t bounds = scppr_vertex_bounds(vertices);
+  glm::vec3 origin = format == scppr::quantized_vertices ? bounds.min : bounds.center;
+  glm::vec3 extent = bounds.max - bounds.min;
+  // flat axes keep a scale of 1, every position on them packs to 0
+  for(int axis = 0; axis < 3; axis++)
+  {
+    if(extent[axis] <= 0)
+    {
+      extent[axis] = 1;
+    }
+  }
+  dequantise = glm::translate(glm::mat4(1), origin);
+  if(format == scppr::quantized_vertices)
+  {
+    dequantise = glm::scale(dequantise, extent);
+  }
+
+  std::vector<scppr::packed_vertex_t> packed(vertices.size());
+  for(size_t i = 0; i < vertices.size(); i++)
+  {
+    const scppr::vertex_t &vertex = vertices[i];
+    scppr::packed_vertex_t &out = packed[i];
+    glm::vec3 position = vertex.position - origin;
+    for(int axis = 0; axis < 3; axis++)
+    {
+      if(format == scppr::quantized_vertices)
+      {
+        float unit = std::min(std::max(position[axis] / extent[axis], 0.0f), 1.0f);
+        out.position[axis] = (uint16_t)std::round(unit * 65535);
+      }
+      else
+      {
+        out.position[axis] = scppr_half(position[axis]);
+      }
+    }
+    out._pad = 0;
+    out.normal = scppr_pack_normal(vertex.normal);
+    out.texture_coord[0] = scppr_half(vertex.texture_coord.x);
+    out.texture_coord[1] = scppr_half(vertex.texture_coord.y);
+  }
+  return packed;
+}
+
+// fnv-1a over the size and the pixels
+uint64_t scppr_image_hash(int width, int height, const unsigned char *rgba)
+{
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&hash](unsigned char byte)
+  {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  };
+  for(int i = 0; i < 4; i++)
+  {
+    mix(width >> (8 * i));
+    mix(height >> (8 * i));
+  }
+  size_t size = (size_t)width * height * 4;
+  for(size_t i = 0; i < size; i++)
+  {
+    mix(rgba[i]);
+  }
+  return hash;
+}
+
+// a decoded image on its way to becoming a shared texture
+struct scppr_image_t
+{
+  std::string path;
+  int width = 0;
+  int height = 0;
+  unsigned char *data = NULL;
+  uint64_t hash = 0;
+  // the pixels sit in the staging ring at staged_offset instead of data
+  bool staged = false;
+  size_t staged_offset = 0;
+};
+
+// part of the cache key, converted meshes depend on them
+const uint32_t scppr_import_flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_OptimizeMeshes;
+
+// the import options that change converted meshes, part of the cache key
+uint32_t scppr_cache_options()
+{
+  return (scppr_optimise_meshes ? 1 : 0) | (scppr_optimise_overdraw ? 2 : 0);
+}
+
+// reorders every level for the vertex cache and then all vertices for fetching, adds the acmr of the full level before and after
+void scppr_optimise_mesh(std::vector<scppr::vertex_t> &vertices, std::vector<GLuint> &indices, const std::vector<scppr::lod_t> &lods, double &before, double &after)
+{
+  for(size_t level = 0; level < lods.size(); level++)
+  {
+    auto first = indices.begin() + lods[level].first_index;
+    std::vector<GLuint> range(first, first + lods[level].index_count);
+    if(!level)
+    {
+      before += scppr::acmr(range, vertices.size()) * range.size() / 3;
+    }
+    scppr::optimise_vertex_cache(range, vertices.size());
+    if(scppr_optimise_overdraw)
+    {
+      scppr::optimise_overdraw(range, (const float *)vertices.data(), vertices.size(), sizeof(scppr::vertex_t));
+    }
+    if(!level)
+    {
+      after += scppr::acmr(range, vertices.size()) * range.size() / 3;
+    }
+    std::copy(range.begin(), range.end(), first);
+  }
+  // the full level comes first, so its first uses decide the order
+  std::vector<uint32_t> order = scppr::optimise_vertex_fetch(indices, vertices.size());
+  std::vector<scppr::vertex_t> reordered(vertices.size());
+  for(size_t i = 0; i < order.size(); i++)
+  {
+    reordered[i] = vertices[order[i]];
+  }
+  vertices.swap(reordered);
+}
+
+std::string scppr_canonical_path(const std::string &path)
+{
+  std::error_code error;
+  std::string canonical = std::filesystem::weakly_canonical(path, error).string();
+  return error ? path : canonical;
+}
+
+// safe on any thread
+bool scppr_texture_cached(const std::string &canonical)
+{
+  std::lock_guard<std::mutex> lock(scppr_texture_mutex);
+  return scppr_textures_by_path.count(canonical);
+}
+
+// safe on any thread
+void scppr_decode_image(scppr_image_t &image)
+{
+  int channels;
+  scppr_DEBUG("decoding texture [" + image.path + "]");
+  image.data = stbi_load(image.path.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha);
+  scppr_ASSERT(image.data, "failed to load texture [" + image.path + "]");
+  image.hash = scppr_image_hash(image.width, image.height, image.data);
+}
+
+// moves decoded pixels into the staging ring when it has room, safe on any thread
+void scppr_stage_image(scppr_image_t &image)
+{
+  if(!scppr_staging || !image.data)
+  {
+    return;
+  }
+  size_t size = (size_t)image.width * image.height * 4;
+  unsigned char *target = scppr_staging -> reserve(size, image.staged_offset);
+  if(!target)
+  {
+    return;
+  }
+  std::copy_n(image.data, size, target);
+  stbi_image_free(image.data);
+  image.data = NULL;
+  image.staged = true;
+}
+
+// gives back what the image still holds without uploading it, safe on any thread
+void scppr_drop_image(scppr_image_t &image)
+{
+  if(image.data)
+  {
+    stbi_image_free(image.data);
+    image.data = NULL;
+  }
+  // nothing read the range, so it needs no fence, and the ring may be gone with its renderer
+  if(image.staged && scppr_staging)
+  {
+    scppr_staging -> release(image.staged_offset);
+  }
+  image.staged = false;
+}
+
+// the hash only narrows the search, a match is read back from the gpu and compared, gl thread only
+bool scppr_texture_matches(const scppr::texture_t *texture, const scppr_image_t &image)
+{
+  if(texture -> width != image.width || texture -> height != image.height)
+  {
+    return false;
+  }
+  std::vector<unsigned char> pixels((size_t)image.width * image.height * 4);
+  GLint previous;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+  GLuint framebuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  int x = 0;
+  int y = 0;
+  if(texture -> slot.array)
+  {
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture -> slot.array -> id, 0, texture -> slot.layer);
+    x = std::lround(texture -> slot.rect.x * texture -> slot.array -> width);
+    y = std::lround(texture -> slot.rect.y * texture -> slot.array -> height);
+  }
+  else
+  {
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture -> t_id, 0);
+  }
+  scppr::gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(x, y, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+  glDeleteFramebuffers(1, &framebuffer);
+  const unsigned char *rgba = image.staged ? scppr_staging -> data(image.staged_offset) : image.data;
+  return std::equal(pixels.begin(), pixels.end(), rgba);
+}
 
-GLint glGetUniformLocation_str(GLint program, std::string location)
+// finds or creates the shared texture for the image, decoding it first when that has not happened yet
+// the pixels are freed, gl thread only
+scppr::texture_t *scppr_share_texture(scppr_image_t &image)
 {
-  return glGetUniformLocation(program, location.c_str());
+  std::unique_lock<std::mutex> lock(scppr_texture_mutex);
+  scppr::texture_t *texture = NULL;
+  auto by_path = scppr_textures_by_path.find(image.path);
+  if(by_path != scppr_textures_by_path.end())
+  {
+    texture = by_path -> second;
+  }
+  else
+  {
+    // the pixels went with the ring of a renderer destroyed since
+    if(image.staged && !scppr_staging)
+    {
+      image.staged = false;
+    }
+    if(!image.data && !image.staged)
+    {
+      lock.unlock();
+      scppr_decode_image(image);
+      lock.lock();
+    }
+    auto by_content = scppr_textures_by_content.find(image.hash);
+    scppr::texture_t *candidate = by_content != scppr_textures_by_content.end() ? by_content -> second : NULL;
+    // only the gl thread adds or deletes textures, so the candidate stays valid while the lock is released for the upload
+    lock.unlock();
+    if(candidate && scppr_texture_matches(candidate, image))
+    {
+      scppr_DEBUG("texture [" + image.path + "] matches one loaded before");
+      texture = candidate;
+    }
+    else if(image.staged)
+    {
+      // with the ring bound as unpack buffer the pixel pointer is an offset into it
+      scppr::gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, scppr_staging -> buffer);
+      texture = new scppr::texture_t(image.width, image.height, (const unsigned char *)image.staged_offset);
+      scppr::gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      // comes back once the upload has read it
+      scppr_staging -> retire(image.staged_offset);
+      image.staged = false;
+    }
+    else
+    {
+      texture = new scppr::texture_t(image.width, image.height, image.data);
+    }
+    lock.lock();
+    if(texture != candidate)
+    {
+      texture -> hash = image.hash;
+      // a colliding image keeps its own texture, the first one stays the one found by content
+      if(!candidate)
+      {
+        scppr_textures_by_content[image.hash] = texture;
+      }
+    }
+    scppr_textures_by_path[image.path] = texture;
+  }
+  scppr_drop_image(image);
+  texture -> references++;
+  return texture;
 }
 
 void scppr_error_callback(int error, const char* description)
 {
-  scppr_LOG(std::string(description));
+  scppr_ERROR(std::string(description));
 }
 
 scppr::texture_t::texture_t(std::string path)
 {
   scppr_ASSERT(scppr_initialised, "scppr is not initialised");
   int width, height, channels;
-  scppr_LOG("attempting to load texture [" + path + "]");
+  scppr_DEBUG("attempting to load texture [" + path + "]");
   unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-  GLenum format = GL_RGBA;
   scppr_ASSERT(data, "failed to load texture [" + path + "]");
-  scppr_LOG("creating texture buffer with " + std::to_string(channels) + "channels");
+  create(width, height, data);
+  stbi_image_free(data);
+}
+
+scppr::texture_t::texture_t(int width, int height, const unsigned char *rgba)
+{
+  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+  create(width, height, rgba);
+}
+
+void scppr::texture_t::create(int width, int height, const unsigned char *rgba)
+{
+  key_id = scppr_next_texture_key++;
+  this -> width = width;
+  this -> height = height;
+  if(scppr_atlas)
+  {
+    scppr_DEBUG("placing texture in a texture array");
+    slot = scppr_atlas -> add(width, height, rgba);
+    t_id = 0;
+    return;
+  }
+  scppr_DEBUG("creating texture buffer of " + std::to_string(width) + "x" + std::to_string(height));
   glGenTextures(1, &t_id);
-  glBindTexture(GL_TEXTURE_2D, t_id);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+  gl_bind_texture(GL_TEXTURE_2D, t_id);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
   glGenerateMipmap(GL_TEXTURE_2D);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  stbi_image_free(data);
 }
 
 scppr::texture_t::~texture_t()
 {
-  // TODO: free texture
-  glDeleteBuffers(1, &t_id);
+  if(slot.array)
+  {
+    slot.array -> release(slot);
+    return;
+  }
+  gl_delete_texture(t_id);
+}
+
+scppr::texture_t *scppr::load_texture(std::string path)
+{
+  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+  scppr_image_t image;
+  image.path = scppr_canonical_path(path);
+  return scppr_share_texture(image);
+}
+
+void scppr::release_texture(texture_t *texture)
+{
+  std::lock_guard<std::mutex> lock(scppr_texture_mutex);
+  if(!texture || --texture -> references)
+  {
+    return;
+  }
+  for(auto it = scppr_textures_by_path.begin(); it != scppr_textures_by_path.end();)
+  {
+    if(it -> second == texture)
+    {
+      it = scppr_textures_by_path.erase(it);
+    }
+    else
+    {
+      it++;
+    }
+  }
+  auto by_content = scppr_textures_by_content.find(texture -> hash);
+  if(by_content != scppr_textures_by_content.end() && by_content -> second == texture)
+  {
+    scppr_textures_by_content.erase(by_content);
+  }
+  delete texture;
+}
+
+scppr::mesh_t::mesh_t(std::vector<vertex_t> vertices, std::vector<GLuint> indices, vertex_format_t format, std::vector<lod_t> lods)
+{
+  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+  assign(vertices, indices, format, lods);
+  if(format == full_vertices)
+  {
+    upload(this -> vertices.data());
+    return;
+  }
+  std::vector<packed_vertex_t> packed = scppr_pack_vertices(this -> vertices, format, dequantise);
+  upload(packed.data());
 }
 
-scppr::mesh_t::mesh_t(std::vector<vertex_t> vertices, std::vector<GLuint> indices)
+scppr::mesh_t::mesh_t(std::vector<vertex_t> vertices, std::vector<GLuint> indices, vertex_format_t format, std::vector<lod_t> lods, const std::vector<packed_vertex_t> &packed, const glm::mat4 &dequantise)
 {
   scppr_ASSERT(scppr_initialised, "scppr is not initialised");
-  this -> vertices = vertices;
-  this -> indices = indices;
+  scppr_ASSERT(format != full_vertices && packed.size() == vertices.size(), "packed vertices do not match the mesh");
+  assign(vertices, indices, format, lods);
+  this -> dequantise = dequantise;
+  upload(packed.data());
+}
+
+void scppr::mesh_t::assign(std::vector<vertex_t> &vertices, std::vector<GLuint> &indices, vertex_format_t format, std::vector<lod_t> &lods)
+{
+  this -> vertices = std::move(vertices);
+  this -> indices = std::move(indices);
+  this -> format = format;
+  this -> lods = std::move(lods);
+  vertex_count = this -> vertices.size();
+  index_count = this -> indices.size();
+  if(this -> lods.empty())
+  {
+    this -> lods.push_back({0, (uint32_t)index_count, 0});
+  }
+  key_id = scppr_next_mesh_key++;
+}
+
+void scppr::mesh_t::upload(const void *vertex_data)
+{
+  if(scppr_geometry[format])
+  {
+    scppr_DEBUG("placing model in shared buffers");
+    // the arenas are drawn with one index type, so they stay 32 bit
+    index_type = GL_UNSIGNED_INT;
+    geometry = scppr_geometry[format];
+    vao = geometry -> vao;
+    vbo = 0;
+    ebo = 0;
+    base_vertex = geometry -> vertices.allocate(vertex_count);
+    geometry -> vertices.upload(base_vertex, vertex_count, vertex_data);
+    first_index = geometry -> indices.allocate(index_count);
+    geometry -> indices.upload(first_index, index_count, this -> indices.data());
+    return;
+  }
 
-  scppr_LOG("creating model buffers");
+  scppr_DEBUG("creating model buffers");
   glGenVertexArrays(1, &vao);
   glGenBuffers(1, &vbo);
   glGenBuffers(1, &ebo);
 
-  scppr_LOG("populating buffer with model");
-  glBindVertexArray(vao);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertex_t), &vertices[0], GL_STATIC_DRAW);
+  scppr_DEBUG("populating buffer with model");
+  gl_bind_vertex_array(vao);
+  gl_bind_buffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertex_count * scppr_vertex_size(format), vertex_data, GL_STATIC_DRAW);
 
-  scppr_LOG("defining buffer structure for model");
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_t), (void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_t), (void*)(3 * sizeof(float)));
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_t), (void*)(5 * sizeof(float)));
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-  glEnableVertexAttribArray(2);
+  scppr_DEBUG("defining buffer structure for model");
+  // instance buffer pointers are set by draw for each batch
+  scppr_vertex_attributes(format);
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+  gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  if(vertex_count < (1 << 16))
+  {
+    index_type = GL_UNSIGNED_SHORT;
+    std::vector<uint16_t> short_indices(this -> indices.begin(), this -> indices.end());
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(uint16_t), short_indices.data(), GL_STATIC_DRAW);
+  }
+  else
+  {
+    index_type = GL_UNSIGNED_INT;
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(GLuint), this -> indices.data(), GL_STATIC_DRAW);
+  }
 
-  scppr_LOG("unbinding buffer");
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  // unbound so later element buffer binds cannot land in this vertex array
+  gl_bind_vertex_array(0);
 }
 
 scppr::mesh_t::~mesh_t()
 {
-  glDeleteVertexArrays(1, &vao);
-  glDeleteBuffers(1, &vbo);
-  glDeleteBuffers(1, &ebo);
+  if(geometry)
+  {
+    geometry -> vertices.free(base_vertex, vertex_count);
+    geometry -> indices.free(first_index, index_count);
+    return;
+  }
+  gl_delete_vertex_array(vao);
+  gl_delete_buffer(vbo);
+  gl_delete_buffer(ebo);
 }
 
-scppr::model_t::model_t(std::string path)
+void scppr::mesh_t::release_geometry()
 {
-  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
-  std::string directory = path.substr(0, path.find_last_of('/')) + "/";
-  scppr_LOG("importing model [" + path + "]");
-  Assimp::Importer _importer;
-  const aiScene *_scene = _importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_OptimizeMeshes);
-  scppr_LOG("checking import");
-  scppr_ASSERT(_scene, "assimp failed to load model: " + std::string(_importer.GetErrorString()));
+  // swapped with empty vectors, clear would keep the capacity
+  std::vector<vertex_t>().swap(vertices);
+  std::vector<GLuint>().swap(indices);
+}
 
-  for(unsigned int i = 0; i < _scene -> mNumMaterials; i++)
+scppr::geometry_t::geometry_t(vertex_format_t format, GLuint instance_vbo, GLuint material_vbo) : vertices(scppr_vertex_size(format), 1 << 16), indices(sizeof(GLuint), 1 << 18)
+{
+  this -> format = format;
+  this -> instance_vbo = instance_vbo;
+  this -> material_vbo = material_vbo;
+  glGenVertexArrays(1, &vao);
+  attach();
+}
+
+scppr::geometry_t::~geometry_t()
+{
+  gl_delete_vertex_array(vao);
+}
+
+void scppr::geometry_t::bind()
+{
+  if(vertex_generation != vertices.generation || index_generation != indices.generation)
   {
-    material_t material;
-    if(_scene -> mMaterials[i] -> GetTextureCount(aiTextureType_DIFFUSE))
+    attach();
+    return;
+  }
+  gl_bind_vertex_array(vao);
+}
+
+void scppr::geometry_t::attach()
+{
+  scppr_DEBUG("pointing shared vertex array at the arenas");
+  gl_bind_vertex_array(vao);
+  gl_bind_buffer(GL_ARRAY_BUFFER, vertices.buffer);
+  scppr_vertex_attributes(format);
+  // base instance moves the instance attributes, so they point at the start of the buffer once
+  scppr_instance_attributes(instance_vbo, material_vbo, 0);
+  gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, indices.buffer);
+  vertex_generation = vertices.generation;
+  index_generation = indices.generation;
+}
+
+// cpu side results of model_t::import, waiting for the gl thread
+struct scppr::model_t::pending_t
+{
+  // diffuse and specular of every material, in turn
+  std::vector<scppr_image_t> images;
+  std::vector<std::vector<vertex_t>> vertices;
+  // every level of a mesh, see build_lods
+  std::vector<std::vector<GLuint>> indices;
+  std::vector<std::vector<lod_t>> lods;
+  // only for packed formats, one for every mesh
+  std::vector<std::vector<packed_vertex_t>> packed;
+  std::vector<glm::mat4> dequantise;
+  std::vector<bounds_t> bounds;
+  std::vector<unsigned int> material_indices;
+  size_t next_material = 0;
+  size_t next_mesh = 0;
+};
+
+scppr::model_t::model_t()
+{
+  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+}
+
+scppr::model_t::model_t(std::string path, vertex_format_t format)
+{
+  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+  this -> format = format;
+  try
+  {
+    import(path);
+    size_t bytes = 0;
+    while(!upload_step(bytes));
+  }
+  catch(const std::exception &e)
+  {
+    // the destructor does not run for a constructor that throws
+    discard();
+    throw;
+  }
+}
+
+void scppr::model_t::import(std::string path)
+{
+  pending = new pending_t();
+  try
+  {
+    convert(path);
+    // packed here so the gl thread only copies them
+    if(format != full_vertices)
+    {
+      pending -> packed.resize(pending -> vertices.size());
+      pending -> dequantise.resize(pending -> vertices.size());
+      for(size_t i = 0; i < pending -> vertices.size(); i++)
+      {
+        pending -> packed[i] = scppr_pack_vertices(pending -> vertices[i], format, pending -> dequantise[i]);
+      }
+    }
+  }
+  catch(const std::exception &e)
+  {
+    // staged pixels would hold up every later range of the staging ring
+    drop_pending();
+    throw;
+  }
+}
+
+void scppr::model_t::convert(std::string path)
+{
+  std::string directory = path.substr(0, path.find_last_of('/')) + "/";
+
+  // files already shared or used twice by this model are decoded at most once
+  std::set<std::string> decoded;
+  auto add_image = [&](const std::string &canonical_path)
+  {
+    scppr_image_t image;
+    image.path = canonical_path;
+    if(!decoded.count(image.path) && !scppr_texture_cached(image.path))
+    {
+      scppr_decode_image(image);
+      scppr_stage_image(image);
+      decoded.insert(image.path);
+    }
+    pending -> images.push_back(image);
+  };
+
+  model_cache_t cache;
+  if(cache.open(path, scppr_import_flags, scppr_cache_options(), sizeof(vertex_t)))
+  {
+    scppr_LOG("importing model [" + path + "] from cache");
+    for(auto &material : cache.materials)
+    {
+      add_image(material.diffuse);
+      add_image(material.specular);
+    }
+    for(auto &mesh : cache.meshes)
+    {
+      const vertex_t *vertices = (const vertex_t *)mesh.vertices;
+      pending -> vertices.push_back(std::vector<vertex_t>(vertices, vertices + mesh.vertex_count));
+      pending -> indices.push_back(std::vector<GLuint>(mesh.indices, mesh.indices + mesh.index_count));
+      pending -> lods.push_back(mesh.lods);
+      pending -> bounds.push_back(mesh.bounds);
+      pending -> material_indices.push_back(mesh.material);
+    }
+    return;
+  }
+
+  scppr_LOG("importing model [" + path + "]");
+  Assimp::Importer _importer;
+  const aiScene *_scene = _importer.ReadFile(path, scppr_import_flags);
+  scppr_DEBUG("checking import");
+  scppr_ASSERT(_scene, "assimp failed to load model: " + std::string(_importer.GetErrorString()));
+
+  auto texture_path = [&](aiMaterial *_material, aiTextureType type, const std::string &fallback)
+  {
+    if(_material -> GetTextureCount(type))
+    {
+      aiString _str;
+      _material -> GetTexture(type, 0, &_str);
+      return scppr_canonical_path(directory + std::string(_str.C_Str()));
+    }
+    return scppr_canonical_path(_assets_path + fallback);
+  };
+  for(unsigned int i = 0; i < _scene -> mNumMaterials; i++)
+  {
+    add_image(texture_path(_scene -> mMaterials[i], aiTextureType_DIFFUSE, "no_texture.png"));
+    add_image(texture_path(_scene -> mMaterials[i], aiTextureType_SPECULAR, "black.jpg"));
+  }
+
+  // weighted by triangles, summed over the meshes
+  double acmr_before = 0;
+  double acmr_after = 0;
+  size_t triangles = 0;
+  for(unsigned int i = 0; i < _scene -> mNumMeshes; i++)
+  {
+    scppr_DEBUG("converting mesh [" + std::to_string(i) + "]");
+    aiMesh *_mesh = _scene -> mMeshes[i];
+    std::vector<vertex_t> vertices;
+    std::vector<GLuint> indices;
+    vertices.reserve(_mesh -> mNumVertices);
+    // triangulated, so every face has three indices
+    indices.reserve(_mesh -> mNumFaces * 3);
+
+    for(unsigned int j = 0; j < _mesh -> mNumVertices; j++)
+    {
+      vertex_t vertex;
+
+      vertex.position.x = _mesh -> mVertices[j].x;
+      vertex.position.y = _mesh -> mVertices[j].y;
+      vertex.position.z = _mesh -> mVertices[j].z;
+
+      vertex.normal.x = _mesh -> mNormals[j].x;
+      vertex.normal.y = _mesh -> mNormals[j].y;
+      vertex.normal.z = _mesh -> mNormals[j].z;
+
+      if(_mesh -> mTextureCoords[0])
+      {
+        vertex.texture_coord.x = _mesh -> mTextureCoords[0][j].x;
+        vertex.texture_coord.y = _mesh -> mTextureCoords[0][j].y;
+      }
+      else
+      {
+        vertex.texture_coord = {0, 0};
+      }
+
+      vertices.push_back(vertex);
+    }
+
+    for(unsigned int i = 0; i < _mesh -> mNumFaces; i++)
+    {
+      aiFace _face = _mesh -> mFaces[i];
+      for(unsigned int j = 0; j < _face.mNumIndices; j++)
+      {
+        indices.push_back(_face.mIndices[j]);
+      }
+    }
+
+    pending -> bounds.push_back(scppr_vertex_bounds(vertices));
+    pending -> lods.push_back(build_lods(indices, (const float *)vertices.data(), vertices.size(), sizeof(vertex_t)));
+    if(scppr_optimise_meshes)
+    {
+      scppr_optimise_mesh(vertices, indices, pending -> lods.back(), acmr_before, acmr_after);
+      triangles += pending -> lods.back()[0].index_count / 3;
+    }
+    pending -> vertices.push_back(std::move(vertices));
+    pending -> indices.push_back(std::move(indices));
+    pending -> material_indices.push_back(_mesh -> mMaterialIndex);
+  }
+
+  if(triangles)
+  {
+    scppr_LOG("vertex cache misses per triangle of [" + path + "] went from " + std::to_string(acmr_before / triangles) + " to " + std::to_string(acmr_after / triangles));
+  }
+
+  // the next start reads the converted meshes back instead of running assimp
+  std::vector<cached_material_t> cached_materials(pending -> images.size() / 2);
+  for(size_t i = 0; i < cached_materials.size(); i++)
+  {
+    cached_materials[i].diffuse = pending -> images[2 * i].path;
+    cached_materials[i].specular = pending -> images[2 * i + 1].path;
+  }
+  std::vector<cached_mesh_t> cached_meshes(pending -> vertices.size());
+  for(size_t i = 0; i < cached_meshes.size(); i++)
+  {
+    cached_meshes[i].vertices = pending -> vertices[i].data();
+    cached_meshes[i].vertex_count = pending -> vertices[i].size();
+    cached_meshes[i].indices = pending -> indices[i].data();
+    cached_meshes[i].index_count = pending -> indices[i].size();
+    cached_meshes[i].material = pending -> material_indices[i];
+    cached_meshes[i].bounds = pending -> bounds[i];
+    cached_meshes[i].lods = pending -> lods[i];
+  }
+  write_model_cache(path, scppr_import_flags, scppr_cache_options(), sizeof(vertex_t), cached_materials, cached_meshes);
+}
+
+bool scppr::model_t::upload_step(size_t &bytes)
+{
+  if(pending -> next_material < pending -> images.size() / 2)
+  {
+    size_t i = pending -> next_material++;
+    for(size_t j = 2 * i; j < 2 * i + 2; j++)
+    {
+      bytes += (size_t)pending -> images[j].width * pending -> images[j].height * 4;
+    }
+    scppr_DEBUG("creating material [" + std::to_string(i) + "]");
+    material_t material;
+    material.diffuse = scppr_share_texture(pending -> images[2 * i]);
+    material.specular = scppr_share_texture(pending -> images[2 * i + 1]);
+    materials.push_back(material);
+    return false;
+  }
+
+  if(pending -> next_mesh < pending -> vertices.size())
+  {
+    size_t i = pending -> next_mesh++;
+    scppr_DEBUG("creating mesh [" + std::to_string(i) + "]");
+    bytes += pending -> vertices[i].size() * scppr_vertex_size(format) + pending -> indices[i].size() * sizeof(GLuint);
+    // the pending vectors are handed over, the mesh is their only owner from here on
+    mesh_t *mesh;
+    if(format == full_vertices)
+    {
+      mesh = new mesh_t(std::move(pending -> vertices[i]), std::move(pending -> indices[i]), format, std::move(pending -> lods[i]));
+    }
+    else
+    {
+      mesh = new mesh_t(std::move(pending -> vertices[i]), std::move(pending -> indices[i]), format, std::move(pending -> lods[i]), pending -> packed[i], pending -> dequantise[i]);
+      // not needed any more, the gpu has its copy
+      std::vector<packed_vertex_t>().swap(pending -> packed[i]);
+    }
+    mesh -> material = materials[pending -> material_indices[i]];
+    mesh -> bounds = pending -> bounds[i];
+    if(scppr_release_geometry)
+    {
+      mesh -> release_geometry();
+    }
+    meshes.push_back(mesh);
+    return false;
+  }
+
+  scppr_DEBUG("computing model bounds");
+  if(!meshes.empty())
+  {
+    bounds.min = meshes[0] -> bounds.min;
+    bounds.max = meshes[0] -> bounds.max;
+    for(auto mesh : meshes)
+    {
+      bounds.min = glm::min(bounds.min, mesh -> bounds.min);
+      bounds.max = glm::max(bounds.max, mesh -> bounds.max);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    for(auto mesh : meshes)
+    {
+      bounds.radius = std::max(bounds.radius, glm::distance(bounds.center, mesh -> bounds.center) + mesh -> bounds.radius);
+    }
+  }
+  delete pending;
+  pending = NULL;
+  ready = true;
+  return true;
+}
+
+scppr::model_t::~model_t()
+{
+  discard();
+}
+
+void scppr::model_t::drop_pending()
+{
+  if(!pending)
+  {
+    return;
+  }
+  for(auto &image : pending -> images)
+  {
+    scppr_drop_image(image);
+  }
+  delete pending;
+  pending = NULL;
+}
+
+void scppr::model_t::discard()
+{
+  drop_pending();
+  for(auto mesh : meshes)
+  {
+    delete mesh;
+  }
+  meshes.clear();
+  for(auto material : materials)
+  {
+    release_texture(material.diffuse);
+    release_texture(material.specular);
+  }
+  materials.clear();
+}
+
+scppr::object_t::object_t()
+{
+  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+}
+
+scppr::object_t::~object_t()
+{
+  if(registry)
+  {
+    registry -> remove(this);
+  }
+}
+
+void scppr::object_t::set_position(glm::dvec3 position)
+{
+  this -> position = position;
+  if(registry)
+  {
+    registry -> mark_dirty(handle);
+  }
+}
+
+void scppr::object_t::set_rotation(glm::dvec3 rotation)
+{
+  this -> rotation = rotation;
+  if(registry)
+  {
+    registry -> mark_dirty(handle);
+  }
+}
+
+void scppr::object_t::set_scale(glm::dvec3 scale)
+{
+  this -> scale = scale;
+  if(registry)
+  {
+    registry -> mark_dirty(handle);
+  }
+}
+
+void scppr::object_t::set_model(model_t *model)
+{
+  this -> model = model;
+  if(registry)
+  {
+    registry -> mark_placement(handle);
+  }
+}
+
+scppr::model_t *scppr::object_t::get_model()
+{
+  return model;
+}
+
+void scppr::object_t::set_static(bool is_static)
+{
+  this -> is_static = is_static;
+  if(registry)
+  {
+    registry -> mark_placement(handle);
+  }
+}
+
+bool scppr::object_t::get_static()
+{
+  return is_static;
+}
+
+glm::dvec3 scppr::object_t::get_position()
+{
+  return position;
+}
+
+glm::dvec3 scppr::object_t::get_rotation()
+{
+  return rotation;
+}
+
+glm::dvec3 scppr::object_t::get_scale()
+{
+  return scale;
+}
+
+scppr::light_t::light_t()
+{
+  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+}
+
+scppr::light_t::~light_t()
+{
+}
+
+scppr::scppr::scppr(std::string name, std::string assets_path, uint32_t flags)
+{
+  _assets_path = assets_path;
+  scppr_ASSERT(!scppr_initialised, "scppr is initialised already");
+  gl_thread = std::this_thread::get_id();
+  headless = flags & SCPPR_HEADLESS;
+  bool null_platform = false;
+#ifdef GLFW_PLATFORM_NULL
+  if(headless && !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY"))
+  {
+    scppr_LOG("no display, using the glfw null platform");
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    null_platform = true;
+  }
+#endif
+  scppr_LOG("creating glfw context");
+  scppr_ASSERT(glfwInit(), "failed to initialise glfw context");
+  glfwSetErrorCallback(scppr_error_callback);
+
+  scppr_LOG("creating glfw window");
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  if(headless)
+  {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  }
+  if(null_platform)
+  {
+    // surfaceless egl first, mesa provides it wherever it runs
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+  }
+  window = glfwCreateWindow(default_width, default_height, name.c_str(), NULL, NULL);
+  if(!window && null_platform)
+  {
+    scppr_WARN("no egl context, trying osmesa");
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    window = glfwCreateWindow(default_width, default_height, name.c_str(), NULL, NULL);
+  }
+  scppr_ASSERT(window, "failed to create glfw window");
+  glfwMakeContextCurrent(window);
+
+  scppr_LOG("attaching listeners");
+  glfwSetWindowUserPointer(window, this);
+  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback_wrap);
+  glfwSetCursorPosCallback(window, mouse_callback_wrap);
+  glfwSetScrollCallback(window, scroll_callback_wrap);
+  glfwSetMouseButtonCallback(window, click_callback_wrap);
+  glfwSetKeyCallback(window, keyboard_callback_wrap);
+
+  scppr_LOG("extracting gl context");
+  scppr_ASSERT(gladLoadGLLoader((GLADloadproc)glfwGetProcAddress), "failed to load glad");
+  gl_reset();
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  keep_frames = headless || (flags & SCPPR_KEEP_FRAMES);
+  if(keep_frames)
+  {
+    scppr_LOG("creating offscreen framebuffer");
+    create_framebuffer();
+    // windows draw to their back buffer and only copy the frame over
+    if(!headless)
+    {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+  }
+
+  scppr_LOG("configuring gl context");
+  glfwSwapInterval(1);
+  gl_enable(GL_BLEND);
+  gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  gl_enable(GL_CULL_FACE);
+
+  scppr_release_geometry = flags & SCPPR_RELEASE_GEOMETRY;
+  scppr_optimise_overdraw = flags & SCPPR_OPTIMISE_OVERDRAW;
+  scppr_optimise_meshes = (flags & SCPPR_OPTIMISE_MESHES) || scppr_optimise_overdraw;
+
+  if(flags & SCPPR_TEXTURE_ARRAYS)
+  {
+    scppr_LOG("creating texture arrays");
+    atlas = new atlas_t();
+    scppr_atlas = atlas;
+    texture_target = GL_TEXTURE_2D_ARRAY;
+    glGenBuffers(1, &material_vbo);
+  }
+
+  if(!atlas)
+  {
+    scppr_LOG("creating texture staging ring");
+    staging = new staging_ring_t(SCPPR_STAGING_SIZE);
+    if(staging -> persistent)
+    {
+      scppr_staging = staging;
+    }
+    else
+    {
+      delete staging;
+      staging = NULL;
+    }
+  }
+
+  scppr_LOG("creating gl render program");
+  std::string defines = atlas ? "#define SCPPR_TEXTURE_ARRAYS\n" : "";
+  simple_light_program = load_program("simple_light", defines);
+  packed_light_program = load_program("simple_light", defines + "#define SCPPR_PACKED_VERTICES\n");
+
+  scppr_LOG("creating light buffer");
+  glGenBuffers(1, &light_ubo);
+  gl_bind_buffer(GL_UNIFORM_BUFFER, light_ubo);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(light_block_t), NULL, GL_DYNAMIC_DRAW);
+  gl_bind_buffer_base(GL_UNIFORM_BUFFER, SCPPR_LIGHT_BINDING, light_ubo);
+
+  scppr_LOG("creating instance buffer");
+  glGenBuffers(1, &instance_vbo);
+
+  if(flags & SCPPR_MULTI_DRAW)
+  {
+    if(GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance)
+    {
+      scppr_LOG("creating shared geometry buffers");
+      for(int format = 0; format < vertex_format_count; format++)
+      {
+        geometry[format] = new geometry_t((vertex_format_t)format, instance_vbo, material_vbo);
+        scppr_geometry[format] = geometry[format];
+      }
+      glGenBuffers(1, &indirect_buffer);
+    }
+    else
+    {
+      scppr_WARN("multi draw indirect is not supported, drawing every batch on its own");
+    }
+  }
+
+  scppr_LOG("initialising camera");
+  set_camera(M_PI / 2, { 0.0, 3.0, 0.0},  -M_PI / 2, 0.0, 0.0, SCPPR_CAMERA_FOV | SCPPR_CAMERA_EYE | SCPPR_CAMERA_PITCH | SCPPR_CAMERA_ROLL | SCPPR_CAMERA_YAW);
+
+  scppr_initialised = true;
+
+  scppr_LOG("initialising environment");
+  default_material.diffuse = load_texture(_assets_path + "no_texture.png");
+  default_material.specular = load_texture(_assets_path + "black.jpg");
+  default_ambient = new light_t();
+  default_ambient -> ambient = {0.15, 0.15, 0.15};
+  default_ambient -> color = {0, 0, 0};
+  default_ambient -> specular = {0, 0, 0};
+  default_ambient -> hidden = true;
+  add_light(default_ambient);
+  scppr_LOG("scppr initialised successfully");
+}
+
+scppr::scppr::~scppr()
+{
+  // the imports write into the staging ring, which goes below, only the ones already running finish
+  closing = true;
+  loaders.shutdown();
+  for(auto model : uploads)
+  {
+    model -> drop_pending();
+    model -> failed = true;
+  }
+  uploads.clear();
+  profile_shutdown();
+  release_texture(default_material.diffuse);
+  release_texture(default_material.specular);
+  delete default_ambient;
+  stop_capture();
+  if(framebuffer)
+  {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &color_renderbuffer);
+    glDeleteRenderbuffers(1, &depth_renderbuffer);
+  }
+  gl_delete_buffer(light_ubo);
+  gl_delete_buffer(instance_vbo);
+  gl_delete_program(simple_light_program.id);
+  gl_delete_program(packed_light_program.id);
+  if(geometry[full_vertices])
+  {
+    gl_delete_buffer(indirect_buffer);
+    for(int format = 0; format < vertex_format_count; format++)
+    {
+      scppr_geometry[format] = NULL;
+      delete geometry[format];
+    }
+  }
+  if(staging)
+  {
+    scppr_staging = NULL;
+    delete staging;
+  }
+  if(atlas)
+  {
+    gl_delete_buffer(material_vbo);
+    scppr_atlas = NULL;
+    delete atlas;
+  }
+  scppr_release_geometry = false;
+  scppr_optimise_meshes = false;
+  scppr_optimise_overdraw = false;
+  scppr_initialised = false;
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+void scppr::scppr::add_object(object_t *obj)
+{
+  objects.add(obj);
+}
+
+void scppr::scppr::remove_object(object_t *obj)
+{
+  objects.remove(obj);
+}
+
+void scppr::scppr::add_light(light_t *light)
+{
+  lights.insert(light);
+}
+
+void scppr::scppr::remove_light(light_t *light)
+{
+  lights.erase(light);
+}
+
+void scppr::scppr::add_listener(listener_t cbt, void *function)
+{
+  add_listener(cbt, function, NULL);
+}
+
+void scppr::scppr::add_listener(listener_t cbt, void *function, void *data_point)
+{
+  listeners[cbt] = std::pair<void *, void *>(function, data_point);
+}
+
+void scppr::scppr::remove_listener(listener_t cbt)
+{
+  listeners.erase(cbt);
+}
+
+bool scppr::scppr::is_open()
+{
+  // a hidden window is never closed by anyone
+  return headless || !glfwWindowShouldClose(window);
+}
+
+void scppr::scppr::poll()
+{
+  glfwPollEvents();
+}
+
+void scppr::scppr::draw()
+{
+  scppr_PROFILE_FRAME();
+  scppr_PROFILE_ZONE("draw");
+  process_uploads();
+
+  scppr_TRACE("resetting camera for new frame");
+  gl_take_state_changes();
+  {
+    scppr_PROFILE_ZONE("clear");
+    scppr_PROFILE_GPU_ZONE("clear");
+    if(headless)
+    {
+      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+    gl_viewport(0, 0, width, height);
+    gl_clear_color(0.0f, 0.0f, 0.4f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gl_enable(GL_DEPTH_TEST);
+    gl_depth_func(GL_LESS);
+  }
+
+  glm::dmat4 projection = glm::perspective(camera_fov, (double)width / (double)height, SCPPR_NEAR, SCPPR_FAR);
+  glm::dmat4 view = glm::lookAt(camera_eye, (camera_eye + camera_front), camera_up);
+  view = glm::rotate(view, camera_roll, camera_front);
+  glm::dmat4 vp = projection * view;
+  last_vp = vp;
+  lod_projection = projection[1][1];
+
+  scppr_TRACE("running programs");
+  {
+    scppr_PROFILE_ZONE("lights");
+    scppr_PROFILE_GPU_ZONE("lights");
+    int count = 0;
+    for(light_t *light : lights)
+    {
+      if(!light -> active)
+      {
+        continue;
+      }
+      if(count == SCPPR_MAX_LIGHTS)
+      {
+        break;
+      }
+      light_entry_t &entry = light_block.lights[count];
+      entry.position = view * glm::dvec4(light -> position, 1);
+      entry.ambient = light -> ambient;
+      entry.diffuse = light -> color;
+      entry.specular = light -> specular;
+      entry.strength = light -> strength;
+      count++;
+    }
+    light_block.light_no = count;
+    gl_bind_buffer(GL_UNIFORM_BUFFER, light_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(light_block_t), &light_block, GL_DYNAMIC_DRAW);
+
+    glm::mat4 f_v = view;
+    glm::mat4 f_p = projection;
+    for(program_t *program : {&simple_light_program, &packed_light_program})
+    {
+      gl_use_program(program -> id);
+      glUniformMatrix4fv(program -> uniforms[uniform_v], 1, GL_FALSE, &f_v[0][0]);
+      glUniformMatrix4fv(program -> uniforms[uniform_p], 1, GL_FALSE, &f_p[0][0]);
+      glUniform1i(program -> uniforms[uniform_material_diffuse], 0);
+      glUniform1i(program -> uniforms[uniform_material_specular], 1);
+      glUniform1f(program -> uniforms[uniform_material_shininess], 32);
+    }
+  }
+
+  prepare_frame(vp);
+
+  {
+    scppr_PROFILE_ZONE("submit");
+    scppr_PROFILE_GPU_ZONE("submit");
+    gl_bind_buffer(GL_ARRAY_BUFFER, instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, instance_upload.size() * sizeof(instance_t), instance_upload.data(), GL_STREAM_DRAW);
+    if(atlas)
+    {
+      atlas -> flush();
+      gl_bind_buffer(GL_ARRAY_BUFFER, material_vbo);
+      glBufferData(GL_ARRAY_BUFFER, material_upload.size() * sizeof(material_instance_t), material_upload.data(), GL_STREAM_DRAW);
+    }
+
+    stats.triangles = 0;
+    if(geometry[full_vertices])
+    {
+      draw_indirect();
+    }
+    else
+    {
+      draw_batches();
+    }
+  }
+  stats.state_changes = gl_take_state_changes();
+  scppr_TRACE("frame took " + std::to_string(stats.draw_calls) + " draw calls and " + std::to_string(stats.state_changes) + " state changes");
+  if(frame_capture)
+  {
+    scppr_PROFILE_ZONE("capture");
+    // a window is read from its back buffer before the swap
+    frame_capture -> capture(headless ? framebuffer : 0, width, height);
+    capture_busy = true;
+    frame_capture -> poll();
+    capture_busy = false;
+  }
+  {
+    std::unique_lock<std::mutex> lock(capture_request_mutex);
+    if(capture_requested)
+    {
+      capture_request_t request = std::move(capture_request);
+      capture_requested = false;
+      lock.unlock();
+      if(request.callback)
+      {
+        start_capture(request.callback, request.format, request.frames);
+      }
+      else
+      {
+        stop_capture();
+      }
+    }
+  }
+
+  // the offscreen framebuffer has nothing to swap, read_pixels takes the frame from there
+  if(!headless)
+  {
+    scppr_PROFILE_ZONE("swap");
+    // the back buffer is undefined once swapped, so read_pixels gets a copy
+    if(keep_frames)
+    {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+      glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    glfwSwapBuffers(window);
+  }
+}
+
+void scppr::scppr::draw_batches()
+{
+  // batches arrive in key order, the state cache drops binds that match the previous batch
+  for(auto &batch : batches)
+  {
+    scppr_PROFILE_ZONE("batch");
+    gl_use_program(batch.mesh -> format == full_vertices ? simple_light_program.id : packed_light_program.id);
+    gl_bind_vertex_array(batch.mesh -> vao);
+    scppr_instance_attributes(instance_vbo, material_vbo, batch.first_instance);
+
+    gl_bind_texture_unit(0, texture_target, batch.diffuse);
+    gl_bind_texture_unit(1, texture_target, batch.specular);
+
+    const lod_t &lod = batch.mesh -> lods[batch.lod];
+    size_t index_size = batch.mesh -> index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+    glDrawElementsInstanced(GL_TRIANGLES, lod.index_count, batch.mesh -> index_type, (void*)(lod.first_index * index_size), batch.instance_count);
+    stats.triangles += lod.index_count / 3 * batch.instance_count;
+  }
+  stats.draw_calls = batches.size();
+}
+
+void scppr::scppr::draw_indirect()
+{
+  commands.resize(batches.size());
+  for(size_t i = 0; i < batches.size(); i++)
+  {
+    batch_t &batch = batches[i];
+    draw_command_t &command = commands[i];
+    const lod_t &lod = batch.mesh -> lods[batch.lod];
+    command.count = lod.index_count;
+    command.instance_count = batch.instance_count;
+    command.first_index = batch.mesh -> first_index + lod.first_index;
+    command.base_vertex = batch.mesh -> base_vertex;
+    command.base_instance = batch.first_instance;
+    stats.triangles += lod.index_count / 3 * batch.instance_count;
+  }
+  gl_bind_buffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(draw_command_t), commands.data(), GL_STREAM_DRAW);
+
+  // vertex formats sort above textures and textures above meshes, so every format and material is one run of commands
+  stats.draw_calls = 0;
+  size_t begin = 0;
+  while(begin < batches.size())
+  {
+    vertex_format_t format = batches[begin].mesh -> format;
+    size_t end = begin + 1;
+    while(end < batches.size() && batches[end].mesh -> format == format && batches[end].diffuse == batches[begin].diffuse && batches[end].specular == batches[begin].specular)
+    {
+      end++;
+    }
+    scppr_PROFILE_ZONE("run");
+    gl_use_program(format == full_vertices ? simple_light_program.id : packed_light_program.id);
+    geometry[format] -> bind();
+    gl_bind_texture_unit(0, texture_target, batches[begin].diffuse);
+    gl_bind_texture_unit(1, texture_target, batches[begin].specular);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(begin * sizeof(draw_command_t)), end - begin, 0);
+    stats.draw_calls++;
+    begin = end;
+  }
+}
+
+void scppr::scppr::prepare_frame(const glm::dmat4 &vp)
+{
+  scppr_PROFILE_ZONE("prepare");
+  {
+    scppr_PROFILE_ZONE("transform");
+    objects.update_transforms(jobs);
+  }
+  {
+    scppr_PROFILE_ZONE("trees");
+    update_trees();
+  }
+  // chunks of candidates, each sorted on its own
+  size_t chunks;
+  {
+    scppr_PROFILE_ZONE("cull");
+    frustum_t frustum = make_frustum(vp);
+    // clip w is the distance along the view direction
+    glm::dvec4 depth_row(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+    std::atomic<uint32_t> submitted(0);
+    std::atomic<uint32_t> culled(0);
+
+    // the trees hand back the handles of objects whose boxes touch the frustum
+    visible.clear();
+    static_tree.query(frustum, visible);
+    dynamic_tree.query(frustum, visible);
+    for(auto &id : visible)
+    {
+      id = objects.index_of(id);
+    }
+    // only objects with a ready model are in the trees, so everything they left out was rejected by the frustum
+    uint32_t tree_culled = static_tree.size() + dynamic_tree.size() - visible.size();
+
+    // every chunk of candidates collects and sorts its own draw items
+    size_t count = visible.size();
+    chunks = (count + SCPPR_PREPARE_GRAIN - 1) / SCPPR_PREPARE_GRAIN;
+    if(chunk_items.size() < chunks)
+    {
+      chunk_items.resize(chunks);
+    }
+    jobs.parallel_for(count, SCPPR_PREPARE_GRAIN, [&](size_t begin, size_t end)
+    {
+      std::vector<draw_item_t> &items = chunk_items[begin / SCPPR_PREPARE_GRAIN];
+      items.clear();
+      uint32_t chunk_submitted = 0;
+      uint32_t chunk_culled = 0;
+      for(size_t i = begin; i < end; i++)
+      {
+        uint32_t index = visible[i];
+        object_t *obj = objects.objects[index];
+        if(!obj -> model || !obj -> model -> ready)
+        {
+          continue;
+        }
+        // hidden objects are tested all the same, so they count as culled whether the tree or this test rejects them
+        if(obj -> hidden)
+        {
+          if(!intersects(frustum, obj -> model -> bounds, objects.transforms[index].model))
+          {
+            chunk_culled++;
+          }
+          continue;
+        }
+        if(collect_draw_items(index, frustum, depth_row, items))
+        {
+          chunk_submitted++;
+        }
+        else
+        {
+          chunk_culled++;
+        }
+      }
+      submitted += chunk_submitted;
+      culled += chunk_culled;
+      std::sort(items.begin(), items.end(), scppr_draw_item_order);
+    });
+    stats.objects_submitted = submitted;
+    stats.objects_culled = culled + tree_culled;
+  }
+
+  {
+    scppr_PROFILE_ZONE("sort");
+    // then the sorted runs are merged pairwise until one is left
+    draw_items.clear();
+    run_bounds.clear();
+    run_bounds.push_back(0);
+    for(size_t chunk = 0; chunk < chunks; chunk++)
+    {
+      draw_items.insert(draw_items.end(), chunk_items[chunk].begin(), chunk_items[chunk].end());
+      run_bounds.push_back(draw_items.size());
+    }
+    while(run_bounds.size() > 2)
+    {
+      size_t runs = run_bounds.size() - 1;
+      jobs.parallel_for(runs / 2, 1, [this](size_t begin, size_t end)
+      {
+        for(size_t pair = begin; pair < end; pair++)
+        {
+          auto first = draw_items.begin() + run_bounds[2 * pair];
+          auto middle = draw_items.begin() + run_bounds[2 * pair + 1];
+          auto last = draw_items.begin() + run_bounds[2 * pair + 2];
+          std::inplace_merge(first, middle, last, scppr_draw_item_order);
+        }
+      });
+      merged_bounds.clear();
+      for(size_t i = 0; i < run_bounds.size(); i += 2)
+      {
+        merged_bounds.push_back(run_bounds[i]);
+      }
+      if(runs % 2)
+      {
+        merged_bounds.push_back(run_bounds.back());
+      }
+      run_bounds.swap(merged_bounds);
+    }
+  }
+
+  {
+    scppr_PROFILE_ZONE("pack");
+    // objects sharing a mesh and material are now adjacent and become one batch
+    batches.clear();
+    size_t begin = 0;
+    while(begin < draw_items.size())
+    {
+      size_t end = begin + 1;
+      while(end < draw_items.size() && scppr_same_state(draw_items[begin], draw_items[end]))
+      {
+        end++;
+      }
+      batch_t batch;
+      batch.mesh = draw_items[begin].mesh;
+      batch.lod = draw_items[begin].lod;
+      batch.diffuse = draw_items[begin].diffuse;
+      batch.specular = draw_items[begin].specular;
+      batch.first_instance = begin;
+      batch.instance_count = end - begin;
+      batches.push_back(batch);
+      begin = end;
+    }
+
+    instance_upload.resize(draw_items.size());
+    material_upload.resize(atlas ? draw_items.size() : 0);
+    jobs.parallel_for(draw_items.size(), SCPPR_PREPARE_GRAIN, [this](size_t begin, size_t end)
+    {
+      for(size_t i = begin; i < end; i++)
+      {
+        instance_upload[i] = objects.transforms[draw_items[i].instance];
+        // the normal matrix stays, packed normals are not scaled with the positions
+        if(draw_items[i].mesh -> format != full_vertices)
+        {
+          instance_upload[i].model = instance_upload[i].model * draw_items[i].mesh -> dequantise;
+        }
+      }
+      if(!atlas)
+      {
+        return;
+      }
+      for(size_t i = begin; i < end; i++)
+      {
+        const texture_slot_t &diffuse = draw_items[i].diffuse_texture -> slot;
+        const texture_slot_t &specular = draw_items[i].specular_texture -> slot;
+        material_upload[i].diffuse_rect = diffuse.rect;
+        material_upload[i].specular_rect = specular.rect;
+        material_upload[i].layers = glm::vec2(diffuse.layer, specular.layer);
+      }
+    });
+  }
+}
+
+scppr::model_t *scppr::scppr::load_model(std::string path, vertex_format_t format)
+{
+  model_t *model = new model_t();
+  model -> format = format;
+  loaders.submit([this, model, path]()
+  {
+    if(closing)
+    {
+      scppr_DEBUG("dropping import of [" + path + "], scppr is shutting down");
+      model -> failed = true;
+      return;
+    }
+    try
+    {
+      model -> import(path);
+    }
+    catch(const std::exception &e)
+    {
+      // the assert has logged why
+      model -> failed = true;
+      return;
+    }
+    std::lock_guard<std::mutex> lock(upload_mutex);
+    uploads.push_back(model);
+  });
+  return model;
+}
+
+void scppr::scppr::process_uploads()
+{
+  scppr_PROFILE_ZONE("uploads");
+  if(staging)
+  {
+    staging -> collect();
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::duration<double> budget(SCPPR_UPLOAD_BUDGET);
+  size_t bytes = 0;
+  while(std::chrono::steady_clock::now() - start < budget && bytes < SCPPR_UPLOAD_BYTES)
+  {
+    model_t *model;
+    {
+      std::lock_guard<std::mutex> lock(upload_mutex);
+      if(uploads.empty())
+      {
+        return;
+      }
+      model = uploads.front();
+    }
+    bool done;
+    try
+    {
+      done = model -> upload_step(bytes);
+    }
+    catch(const std::exception &e)
+    {
+      // the images it has not reached yet would hold up the staging ring until the model is deleted
+      model -> drop_pending();
+      model -> failed = true;
+      done = true;
+    }
+    if(!done)
     {
-      aiString _str;
-      _scene -> mMaterials[i] -> GetTexture(aiTextureType_DIFFUSE, 0, &_str);
-      std::string str = std::string(_str.C_Str());
-      material.diffuse = new texture_t(directory + str);
+      continue;
     }
-    else
     {
-      material.diffuse = new texture_t(_assets_path + "no_texture.png");
+      std::lock_guard<std::mutex> lock(upload_mutex);
+      uploads.pop_front();
+    }
+    // the objects waiting for it are placed by the next update_trees
+    finished_models.push_back(model);
+  }
+}
+
+void scppr::scppr::update_trees()
+{
+  // added, removed and changed objects move in and out one at a time
+  bool static_changed = false;
+  objects.take_placements(placements);
+  for(uint32_t handle : placements)
+  {
+    // the handle may have changed hands since, whatever it held goes first
+    if(static_tree.contains(handle))
+    {
+      static_tree.remove(handle);
+      static_changed = true;
     }
-    if(_scene -> mMaterials[i] -> GetTextureCount(aiTextureType_SPECULAR))
+    dynamic_tree.remove(handle);
+    if(!objects.alive(handle))
     {
-      aiString _str;
-      _scene -> mMaterials[i] -> GetTexture(aiTextureType_SPECULAR, 0, &_str);
-      std::string str = std::string(_str.C_Str());
-      material.specular = new texture_t(directory + str);
+      continue;
     }
-    else
+    bvh_t *tree = place(handle);
+    model_t *model = objects.objects[objects.index_of(handle)] -> model;
+    // objects without a model come back through set_model, the others wait for theirs to finish loading
+    if(!tree && model)
     {
-      material.specular = new texture_t(_assets_path + "black.jpg");
+      waiting[model].push_back(handle);
     }
-    materials.push_back(material);
+    static_changed = tree == &static_tree || static_changed;
   }
-
-  for(unsigned int i = 0; i < _scene -> mNumMeshes; i++)
+  // only the objects of models that finished since the last frame are looked at
+  for(model_t *model : finished_models)
   {
-    scppr_LOG("creating mesh [" + std::to_string(i) + "]");
-    aiMesh *_mesh = _scene -> mMeshes[i];
-    std::vector<vertex_t> vertices;
-    std::vector<GLuint> indices;
-
-    for(unsigned int j = 0; j < _mesh -> mNumVertices; j++)
+    auto it = waiting.find(model);
+    if(it == waiting.end())
     {
-      vertex_t vertex;
-
-      vertex.position.x = _mesh -> mVertices[j].x;
-      vertex.position.y = _mesh -> mVertices[j].y;
-      vertex.position.z = _mesh -> mVertices[j].z;
-
-      vertex.normal.x = _mesh -> mNormals[j].x;
-      vertex.normal.y = _mesh -> mNormals[j].y;
-      vertex.normal.z = _mesh -> mNormals[j].z;
-
-      if(_mesh -> mTextureCoords[0])
-      {
-        vertex.texture_coord.x = _mesh -> mTextureCoords[0][j].x;
-        vertex.texture_coord.y = _mesh -> mTextureCoords[0][j].y;
-      }
-      else
-      {
-        vertex.texture_coord = {0, 0};
-      }
-
-      vertices.push_back(vertex);
+      continue;
     }
-
-    for(unsigned int i = 0; i < _mesh -> mNumFaces; i++)
+    for(uint32_t handle : it -> second)
     {
-      aiFace _face = _mesh -> mFaces[i];
-      for(unsigned int j = 0; j < _face.mNumIndices; j++)
+      // removed, handed to another object or given another model in the meantime
+      if(!objects.alive(handle) || objects.objects[objects.index_of(handle)] -> model != model || static_tree.contains(handle) || dynamic_tree.contains(handle))
       {
-        indices.push_back(_face.mIndices[j]);
+        continue;
       }
+      static_changed = place(handle) == &static_tree || static_changed;
     }
-
-    mesh_t *mesh = new mesh_t(vertices, indices);
-    mesh -> material = materials[_mesh -> mMaterialIndex];
-    meshes.push_back(mesh);
+    waiting.erase(it);
+  }
+  finished_models.clear();
+  if(static_changed)
+  {
+    scppr_DEBUG("rebuilding static object tree");
+    static_tree.rebuild();
   }
-}
 
-scppr::model_t::~model_t()
-{
-  for(auto mesh : meshes)
+  for(uint32_t index : objects.updated())
   {
-    delete mesh;
+    object_t *obj = objects.objects[index];
+    if(!obj -> model || !obj -> model -> ready)
+    {
+      continue;
+    }
+    uint32_t handle = objects.handle_of(index);
+    box_t box = world_box(obj -> model -> bounds, objects.transforms[index].model);
+    if(static_tree.contains(handle))
+    {
+      static_tree.refit(handle, box);
+    }
+    else if(dynamic_tree.contains(handle))
+    {
+      dynamic_tree.refit(handle, box);
+    }
   }
-  for(auto material : materials)
+  // inserts do not balance the tree, a build every size / 2 of them keeps them cheap on average
+  if(dynamic_tree.growth() > SCPPR_BVH_REBUILD_GROWTH || dynamic_tree.changes() > dynamic_tree.size() / 2)
   {
-    delete material.diffuse;
-    delete material.specular;
+    scppr_DEBUG("rebuilding dynamic object tree");
+    dynamic_tree.rebuild();
   }
 }
 
-scppr::object_t::object_t()
-{
-  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
-}
-
-scppr::object_t::~object_t()
-{
-}
-
-scppr::light_t::light_t()
+scppr::bvh_t *scppr::scppr::place(uint32_t handle)
 {
-  scppr_ASSERT(scppr_initialised, "scppr is not initialised");
+  uint32_t index = objects.index_of(handle);
+  object_t *obj = objects.objects[index];
+  if(!obj -> model || !obj -> model -> ready)
+  {
+    return NULL;
+  }
+  bvh_t *tree = obj -> is_static ? &static_tree : &dynamic_tree;
+  tree -> insert(handle, world_box(obj -> model -> bounds, objects.transforms[index].model));
+  return tree;
 }
 
-scppr::light_t::~light_t()
+scppr::object_t *scppr::scppr::pick(double x, double y)
 {
+  // the hidden window of a headless renderer keeps its first size, the framebuffer is what was drawn
+  int window_width = width;
+  int window_height = height;
+  if(!headless)
+  {
+    glfwGetWindowSize(window, &window_width, &window_height);
+  }
+  if(window_width <= 0 || window_height <= 0)
+  {
+    return NULL;
+  }
+  double ndc_x = 2 * x / window_width - 1;
+  double ndc_y = 1 - 2 * y / window_height;
+  glm::dmat4 inverse_vp = glm::inverse(last_vp);
+  glm::dvec4 near_point = inverse_vp * glm::dvec4(ndc_x, ndc_y, -1, 1);
+  glm::dvec4 far_point = inverse_vp * glm::dvec4(ndc_x, ndc_y, 1, 1);
+  glm::dvec3 near_world = glm::dvec3(near_point) / near_point.w;
+  glm::dvec3 far_world = glm::dvec3(far_point) / far_point.w;
+  glm::vec3 origin = near_world;
+  glm::vec3 direction = glm::normalize(far_world - near_world);
+
+  hits.clear();
+  static_tree.raycast(origin, direction, hits);
+  dynamic_tree.raycast(origin, direction, hits);
+  std::sort(hits.begin(), hits.end());
+
+  object_t *result = NULL;
+  float best = std::numeric_limits<float>::infinity();
+  for(auto &hit : hits)
+  {
+    // boxes are sorted by entry distance, nothing further along can beat the best triangle
+    if(hit.first > best)
+    {
+      break;
+    }
+    // objects removed since the last frame are still in the trees
+    if(!objects.alive(hit.second))
+    {
+      continue;
+    }
+    uint32_t index = objects.index_of(hit.second);
+    object_t *obj = objects.objects[index];
+    if(obj -> hidden || !obj -> model || !obj -> model -> ready)
+    {
+      continue;
+    }
+    // the direction is not renormalised in model space so t stays a world distance
+    glm::mat4 inverse_model = glm::inverse(objects.transforms[index].model);
+    glm::vec3 model_origin = glm::vec3(inverse_model * glm::vec4(origin, 1));
+    glm::vec3 model_direction = glm::vec3(inverse_model * glm::vec4(direction, 0));
+    for(auto mesh : obj -> model -> meshes)
+    {
+      if(mesh -> indices.empty())
+      {
+        // no geometry kept on the cpu, the box has to do
+        if(hit.first < best)
+        {
+          best = hit.first;
+          result = obj;
+        }
+        continue;
+      }
+      // the full level, the simplified ones follow it
+      const lod_t &full = mesh -> lods[0];
+      for(size_t i = full.first_index; i + 2 < full.first_index + full.index_count; i += 3)
+      {
+        float t = ray_triangle(model_origin, model_direction,
+          mesh -> vertices[mesh -> indices[i]].position,
+          mesh -> vertices[mesh -> indices[i + 1]].position,
+          mesh -> vertices[mesh -> indices[i + 2]].position);
+        if(t >= 0 && t < best)
+        {
+          best = t;
+          result = obj;
+        }
+      }
+    }
+  }
+  return result;
 }
 
-scppr::scppr::scppr(std::string name, std::string assets_path)
+bool scppr::scppr::collect_draw_items(uint32_t index, const frustum_t &frustum, const glm::dvec4 &depth_row, std::vector<draw_item_t> &items)
 {
-  _assets_path = assets_path;
-  scppr_ASSERT(!scppr_initialised, "scppr is initialised already");
-  scppr_LOG("creating glfw context");
-  scppr_ASSERT(glfwInit(), "failed to initialise glfw context");
-  glfwSetErrorCallback(scppr_error_callback);
-
-  scppr_LOG("creating glfw window");
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  window = glfwCreateWindow(default_width, default_height, name.c_str(), NULL, NULL);
-  scppr_ASSERT(window, "failed to create glfw window");
-  glfwMakeContextCurrent(window);
-
-  scppr_LOG("attaching listeners");
-  glfwSetWindowUserPointer(window, this);
-  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback_wrap);
-  glfwSetCursorPosCallback(window, mouse_callback_wrap);
-  glfwSetScrollCallback(window, scroll_callback_wrap);
-  glfwSetMouseButtonCallback(window, click_callback_wrap);
-  glfwSetKeyCallback(window, keyboard_callback_wrap);
-
-  scppr_LOG("extracting gl context");
-  scppr_ASSERT(gladLoadGLLoader((GLADloadproc)glfwGetProcAddress), "failed to load glad");
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  scppr_LOG("configuring gl context");
-  glfwSwapInterval(1);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable(GL_CULL_FACE);
-
-  scppr_LOG("creating gl render program");
-  simple_light_program = load_program("simple_light");
-
-  scppr_LOG("initialising camera");
-  set_camera(M_PI / 2, { 0.0, 3.0, 0.0},  -M_PI / 2, 0.0, 0.0, SCPPR_CAMERA_FOV | SCPPR_CAMERA_EYE | SCPPR_CAMERA_PITCH | SCPPR_CAMERA_ROLL | SCPPR_CAMERA_YAW);
-
-  scppr_initialised = true;
-
-  scppr_LOG("initialising environment");
-  default_material.diffuse = new texture_t(_assets_path + "no_texture.png");
-  default_material.specular = new texture_t(_assets_path + "black.jpg");
-  default_ambient = new light_t();
-  default_ambient -> ambient = {0.15, 0.15, 0.15};
-  default_ambient -> color = {0, 0, 0};
-  default_ambient -> specular = {0, 0, 0};
-  default_ambient -> hidden = true;
-  add_light(default_ambient);
-  scppr_LOG("scppr initialised successfully");
-}
+  object_t *obj = objects.objects[index];
+  const glm::mat4 &model = objects.transforms[index].model;
+  if(!intersects(frustum, obj -> model -> bounds, model))
+  {
+    return false;
+  }
 
-scppr::scppr::~scppr()
-{
-  delete default_material.diffuse;
-  delete default_material.specular;
-  delete default_ambient;
-  scppr_initialised = false;
-  glfwDestroyWindow(window);
-  glfwTerminate();
-}
+  // front to back within a batch so early depth testing rejects more fragments
+  glm::dvec4 center = glm::dvec4(model * glm::vec4(obj -> model -> bounds.center, 1));
+  double w = glm::dot(depth_row, center);
+  double distance = glm::clamp(w / SCPPR_FAR, 0.0, 1.0);
+  uint32_t depth = distance * ((1 << SCPPR_KEY_DEPTH_BITS) - 1);
+
+  // level 0 takes screen sizes from lod_screen_size up, level k the ones above lod_screen_size / 2^k up to lod_screen_size / 2^(k-1), the last level everything smaller
+  float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+  double size = w > 0 ? obj -> model -> bounds.radius * scale * lod_projection / w : lod_screen_size;
+  uint32_t level = 0;
+  if(size < lod_screen_size)
+  {
+    // clamped before the cast, an empty sphere has a size of 0
+    double halvings = std::min(std::log2(lod_screen_size / size), (double)SCPPR_LOD_LEVELS);
+    level = std::min((uint32_t)halvings + 1, SCPPR_LOD_LEVELS - 1);
+  }
+  if(level != obj -> lod)
+  {
+    // the last level is kept until the size is clearly past one of its boundaries
+    double upper = obj -> lod ? lod_screen_size / (1 << (obj -> lod - 1)) : INFINITY;
+    double lower = obj -> lod < SCPPR_LOD_LEVELS - 1 ? lod_screen_size / (1 << obj -> lod) : 0;
+    if(size < upper * (1 + lod_hysteresis) && size > lower * (1 - lod_hysteresis))
+    {
+      level = obj -> lod;
+    }
+  }
+  obj -> lod = level;
 
-void scppr::scppr::add_object(object_t *obj)
-{
-  objects.insert(obj);
-}
+  for(size_t i = 0; i < obj -> model -> meshes.size(); i++)
+  {
+    mesh_t *mesh = obj -> model -> meshes[i];
+    auto it = obj -> material_overwrite.find((int)i);
+    texture_t *diffuse = mesh -> material.diffuse;
+    texture_t *specular = mesh -> material.specular;
+    if(it != obj -> material_overwrite.end())
+    {
+      diffuse = it -> second.diffuse ? it -> second.diffuse : default_material.diffuse;
+      specular = it -> second.specular ? it -> second.specular : default_material.specular;
+    }
 
-void scppr::scppr::remove_object(object_t *obj)
-{
-  objects.erase(obj);
+    draw_item_t item;
+    item.mesh = mesh;
+    item.instance = index;
+    // meshes too small to simplify stop early
+    item.lod = std::min<uint32_t>(level, mesh -> lods.size() - 1);
+    item.diffuse = scppr_texture_name(diffuse);
+    item.specular = scppr_texture_name(specular);
+    item.diffuse_texture = diffuse;
+    item.specular_texture = specular;
+    // each vertex format draws with its own program and vertex array
+    item.key = scppr_draw_key(mesh -> format, scppr_texture_key(diffuse), scppr_texture_key(specular), mesh -> key_id, item.lod, depth);
+    items.push_back(item);
+  }
+  return true;
 }
 
-void scppr::scppr::add_light(light_t *light)
+void scppr::scppr::set_lod(double screen_size, double hysteresis)
 {
-  lights.insert(light);
+  lod_screen_size = screen_size;
+  lod_hysteresis = hysteresis;
 }
 
-void scppr::scppr::remove_light(light_t *light)
+scppr::frame_stats_t scppr::scppr::get_stats()
 {
-  lights.erase(light);
+  return stats;
 }
 
-void scppr::scppr::add_listener(listener_t cbt, void *function)
+void scppr::scppr::set_size(int width, int height)
 {
-  add_listener(cbt, function, NULL);
+  if(!headless)
+  {
+    scppr_WARN("set_size is ignored with a window, it follows the window");
+    return;
+  }
+  this -> width = width;
+  this -> height = height;
+  create_framebuffer();
 }
 
-void scppr::scppr::add_listener(listener_t cbt, void *function, void *data_point)
+std::vector<unsigned char> scppr::scppr::read_pixels()
 {
-  listeners[cbt] = std::pair<void *, void *>(function, data_point);
+  scppr_ASSERT(keep_frames, "read_pixels needs SCPPR_HEADLESS or SCPPR_KEEP_FRAMES");
+  size_t row = (size_t)width * 4;
+  std::vector<unsigned char> pixels(row * height);
+  // windows copied their last frame here before the swap
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  if(!headless)
+  {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  }
+  // gl has the bottom row first
+  std::vector<unsigned char> swapped(row);
+  for(int y = 0; y < height / 2; y++)
+  {
+    unsigned char *top = pixels.data() + y * row;
+    unsigned char *bottom = pixels.data() + (height - 1 - y) * row;
+    std::copy_n(top, row, swapped.data());
+    std::copy_n(bottom, row, top);
+    std::copy_n(swapped.data(), row, bottom);
+  }
+  return pixels;
 }
 
-void scppr::scppr::remove_listener(listener_t cbt)
+bool scppr::scppr::defer_capture(capture_request_t request)
 {
-  listeners.erase(cbt);
+  // converted frames reach their callback on a converter thread, which the capture joins when it goes
+  if(!capture_busy && std::this_thread::get_id() == gl_thread)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(capture_request_mutex);
+  capture_request = std::move(request);
+  capture_requested = true;
+  return true;
 }
 
-bool scppr::scppr::is_open()
+void scppr::scppr::start_capture(capture_callback_t callback, capture_format_t format, uint32_t frames)
 {
-  return !glfwWindowShouldClose(window);
+  if(defer_capture({callback, format, frames}))
+  {
+    return;
+  }
+  stop_capture();
+  scppr_LOG("starting frame capture");
+  frame_capture = new capture_t(frames, format, callback);
 }
 
-void scppr::scppr::poll()
+void scppr::scppr::stop_capture()
 {
-  glfwPollEvents();
+  if(defer_capture({capture_callback_t(), capture_rgba, 0}) || !frame_capture)
+  {
+    return;
+  }
+  scppr_LOG("stopping frame capture");
+  // the flush hands over what is in flight, its callbacks see the capture stopped already
+  capture_t *stopped = frame_capture;
+  frame_capture = NULL;
+  capture_busy = true;
+  delete stopped;
+  capture_busy = false;
+  // a stop asked for by those callbacks is done, left for draw it would stop a capture started after this one
+  std::lock_guard<std::mutex> lock(capture_request_mutex);
+  if(capture_requested && !capture_request.callback)
+  {
+    capture_requested = false;
+  }
 }
 
-void scppr::scppr::draw()
+void scppr::scppr::create_framebuffer()
 {
-  scppr_LOG("resetting camera for new frame");
-  glViewport(0, 0, width, height);
-  glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glEnable(GL_DEPTH_TEST);
-  glDepthFunc(GL_LESS);
-
-  glm::dmat4 projection = glm::perspective(camera_fov, (double)width / (double)height, 0.1, 100.0);
-  glm::dmat4 view = glm::lookAt(camera_eye, (camera_eye + camera_front), camera_up);
-  view = glm::rotate(view, camera_roll, camera_front);
-  glm::dmat4 vp = projection * view;
-
-  scppr_LOG("running programs");
-  GLuint program;
-
-  glUseProgram(simple_light_program);
-  program = simple_light_program;
-
-  for(auto obj : objects)
+  if(!framebuffer)
   {
-    if(obj -> hidden)
-    {
-      continue;
-    }
-
-    glm::dmat4 model = glm::dmat4(1);
-               model = glm::translate(model, glm::dvec3(obj -> position));
-               model = glm::rotate(model, obj -> rotation.x, {1, 0, 0});
-               model = glm::rotate(model, obj -> rotation.y, {0, 1, 0});
-               model = glm::rotate(model, obj -> rotation.z, {0, 0, 1});
-               model = glm::scale(model, obj -> scale);
-
-    glm::mat4 f_m = model;
-    glUniformMatrix4fv(glGetUniformLocation(program, "m"), 1, GL_FALSE, &f_m[0][0]);
-    glm::mat4 f_v = view;
-    glUniformMatrix4fv(glGetUniformLocation(program, "v"), 1, GL_FALSE, &f_v[0][0]);
-    glm::mat4 f_p = projection;
-    glUniformMatrix4fv(glGetUniformLocation(program, "p"), 1, GL_FALSE, &f_p[0][0]);
-    glm::mat3 f_nmv = glm::mat3(glm::transpose(glm::inverse(view * model)));
-    glUniformMatrix3fv(glGetUniformLocation(program, "nmv"), 1, GL_FALSE, &f_nmv[0][0]);
-    int count = 0;
-    for(light_t *light : lights)
-    {
-      if(!light -> active)
-      {
-        continue;
-      }
-      glm::vec3 f_lp = view * glm::vec4(light -> position, 1);
-      std::string header = "lights[" + std::to_string(count) + "]";
-      glUniform3fv(glGetUniformLocation_str(program, header + ".position"), 1, &f_lp[0]);
-      glm::vec3 f_la = light -> ambient;
-      glUniform3fv(glGetUniformLocation_str(program, header + ".ambient"), 1, &f_la[0]);
-      glm::vec3 f_lc = light -> color;
-      glUniform3fv(glGetUniformLocation_str(program, header + ".diffuse"), 1, &f_lc[0]);
-      glm::vec3 f_ls = light -> specular;
-      glUniform3fv(glGetUniformLocation_str(program, header + ".specular"), 1, &f_ls[0]);
-      glUniform1f(glGetUniformLocation_str(program, header + ".strength"), light -> strength);
-      count++;
-    }
-    glUniform1i(glGetUniformLocation(program, "light_no"), count);
-    for(int i = 0; i < obj -> model -> meshes.size(); i++)
-    {
-      mesh_t *mesh = obj -> model -> meshes[i];
-      glBindVertexArray(mesh -> vao);
-      auto it = obj -> material_overwrite.find(i);
-      material_t overwrite;
-      bool overwritten = false;
-      if(it != obj -> material_overwrite.end())
-      {
-        overwrite = it -> second;
-        overwritten = true;
-      }
-
-      GLuint t_id = mesh -> material.diffuse -> t_id;
-      if(overwritten)
-      {
-        if(overwrite.diffuse)
-        {
-          t_id = overwrite.diffuse -> t_id;
-        }
-        else
-        {
-          t_id = default_material.diffuse -> t_id;
-        }
-      }
-      glUniform1i(glGetUniformLocation(program, "material.diffuse"), 0);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, t_id);
-
-      t_id = mesh -> material.specular -> t_id;
-      if(overwritten)
-      {
-        if(overwrite.specular)
-        {
-          t_id = overwrite.specular -> t_id;
-        }
-        else
-        {
-          t_id = default_material.specular -> t_id;
-        }
-      }
-      glUniform1i(glGetUniformLocation(program, "material.specular"), 1);
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, t_id);
-
-      glUniform1f(glGetUniformLocation(program, "material.shininess"), 32);
-
-      glDrawElements(GL_TRIANGLES, mesh -> indices.size(), GL_UNSIGNED_INT, 0);
-
-      glBindVertexArray(0);
-    }
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &color_renderbuffer);
+    glGenRenderbuffers(1, &depth_renderbuffer);
   }
-
-  glfwSwapBuffers(window);
+  scppr_DEBUG("sizing offscreen framebuffer to " + std::to_string(width) + "x" + std::to_string(height));
+  glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+  scppr_ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is incomplete");
 }
 
 double scppr::scppr::get_width()
@@ -498,9 +2277,19 @@ void scppr::scppr::keyboard_callback_wrap(GLFWwindow* window, int key, int scanc
 
 void scppr::scppr::framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+  if(headless)
+  {
+    return;
+  }
   this -> width = width;
   this -> height = height;
-  glViewport(0, 0, width, height);
+  gl_viewport(0, 0, width, height);
+  // a minimised window has no size, the copy keeps its old one until it comes back
+  if(keep_frames && width > 0 && height > 0)
+  {
+    create_framebuffer();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
 }
 
 void scppr::scppr::mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -2,12 +2,29 @@
 #define LIB_SCPPR_H
 
 #include "glad.h"
+#include "lib/shader/shader.h"
+#include "lib/registry/registry.h"
+#include "lib/job/job.h"
+#include "lib/cull/cull.h"
+#include "lib/bvh/bvh.h"
+#include "lib/arena/arena.h"
+#include "lib/atlas/atlas.h"
+#include "lib/staging/staging.h"
+#include "lib/model_cache/model_cache.h"
+#include "lib/lod/lod.h"
+#include "lib/vertex_cache/vertex_cache.h"
+#include "lib/capture/capture.h"
+#include "lib/profile/profile.h"
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <string>
 #include <set>
 #include <map>
 #include <vector>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace scppr
 {
@@ -18,6 +35,24 @@ namespace scppr
   static const uint32_t SCPPR_CAMERA_PITCH = 4;
   static const uint32_t SCPPR_CAMERA_ROLL = 8;
   static const uint32_t SCPPR_CAMERA_YAW = 16;
+
+  // scppr construction flags
+  // all meshes share a few buffers and a frame is drawn with one multi draw indirect per material
+  static const uint32_t SCPPR_MULTI_DRAW = 1;
+  // textures are packed into texture arrays, meshes only differing in textures from the same arrays share a batch
+  static const uint32_t SCPPR_TEXTURE_ARRAYS = 2;
+  // model meshes drop their cpu side vertices and indices once uploaded, picking falls back to bounding boxes
+  static const uint32_t SCPPR_RELEASE_GEOMETRY = 4;
+  // imported meshes get their triangles reordered for the post transform cache and their vertices for fetching
+  static const uint32_t SCPPR_OPTIMISE_MESHES = 8;
+  // as SCPPR_OPTIMISE_MESHES, with outward facing clusters of triangles drawn first to cut overdraw
+  static const uint32_t SCPPR_OPTIMISE_OVERDRAW = 16;
+  // no visible window, frames go to an offscreen framebuffer and are fetched with read_pixels
+  // without a display glfw 3.4 falls back to its null platform with an egl or osmesa context, llvmpipe is enough
+  static const uint32_t SCPPR_HEADLESS = 32;
+  // windows copy every frame into an offscreen framebuffer before the swap, so read_pixels can fetch it
+  // the front buffer cannot be read back reliably, covered parts are undefined and compositors may keep it
+  static const uint32_t SCPPR_KEEP_FRAMES = 64;
   extern std::string _assets_path;
 
   // enums
@@ -29,6 +64,40 @@ namespace scppr
     keyboard_listener
   };
 
+  // layouts a model's meshes are uploaded in, chosen per model
+  enum vertex_format_t
+  {
+    // 32 bytes of floats
+    full_vertices,
+    // 16 bytes, half float positions around the mesh center, octahedral normals and half float texture coordinates
+    half_vertices,
+    // 16 bytes, 16 bit positions within the mesh bounds, otherwise as half_vertices
+    quantized_vertices,
+    vertex_format_count
+  };
+
+  static const double SCPPR_NEAR = 0.1;
+  static const double SCPPR_FAR = 100;
+
+  // time spent per frame turning loaded models into gl objects
+  static const double SCPPR_UPLOAD_BUDGET = 0.004;
+  // bytes handed to gl per frame for loaded models, the step crossing it still completes
+  static const size_t SCPPR_UPLOAD_BYTES = 32 << 20;
+  // pixels of decoded textures waiting for upload, larger images go the slow way
+  static const size_t SCPPR_STAGING_SIZE = 64 << 20;
+  static const unsigned int SCPPR_LOADER_THREADS = 2;
+
+  // fraction of the viewport height an object's bounding sphere spans below which it drops to its first simplified level
+  // every halving of that drops another level
+  static const double SCPPR_LOD_SCREEN_SIZE = 0.5;
+  // how far past a level boundary an object has to move before its level changes, relative to the boundary
+  static const double SCPPR_LOD_HYSTERESIS = 0.15;
+
+  // objects per job when preparing a frame
+  static const size_t SCPPR_PREPARE_GRAIN = 1024;
+  // the dynamic object tree is rebuilt once refits grow its root by this factor
+  static const float SCPPR_BVH_REBUILD_GROWTH = 2;
+
   static int default_width = 800;
   static int default_height = 800;
 
@@ -39,15 +108,43 @@ namespace scppr
     glm::vec3 normal;
   };
 
+  // gpu layout of half_vertices and quantized_vertices
+  struct packed_vertex_t
+  {
+    uint16_t position[3];
+    uint16_t _pad;
+    // octahedral encoding in x and y of a signed 10:10:10:2 value
+    uint32_t normal;
+    uint16_t texture_coord[2];
+  };
+
   class texture_t
   {
   public:
     texture_t(std::string path);
+    // 4 bytes per pixel
+    texture_t(int width, int height, const unsigned char *rgba);
     ~texture_t();
     // do not fiddle with this
     GLuint t_id;
+    // small dense number used in draw sort keys
+    uint32_t key_id;
+    // set when the texture lives in a texture array, t_id is not used then
+    texture_slot_t slot;
+    // bookkeeping of load_texture
+    uint32_t references = 0;
+    uint64_t hash = 0;
+    int width = 0;
+    int height = 0;
+  private:
+    void create(int width, int height, const unsigned char *rgba);
   };
 
+  // shared textures, every file and every distinct image is uploaded once
+  // hand them back with release_texture instead of deleting them
+  texture_t *load_texture(std::string path);
+  void release_texture(texture_t *texture);
+
   class material_t
   {
   public:
@@ -55,28 +152,99 @@ namespace scppr
     texture_t *specular = NULL;
   };
 
+  // vertex and index arenas shared by every mesh of one vertex format with one vertex array over both, used by the multi draw path
+  class geometry_t
+  {
+  public:
+    geometry_t(vertex_format_t format, GLuint instance_vbo, GLuint material_vbo);
+    ~geometry_t();
+    // binds the shared vertex array, setting it up again when an arena had to grow
+    void bind();
+    arena_t vertices;
+    arena_t indices;
+    GLuint vao;
+    vertex_format_t format;
+  private:
+    void attach();
+    GLuint instance_vbo;
+    GLuint material_vbo;
+    uint64_t vertex_generation;
+    uint64_t index_generation;
+  };
+
   class mesh_t
   {
     public:
-    mesh_t(std::vector<vertex_t> vertices, std::vector<GLuint> indices);
+    // pass the vectors as rvalues to hand them over without copies
+    // the cpu side copy stays in full vertices whatever the format
+    // indices may hold simplified levels after the full one, lods then gives their ranges, the full one first
+    mesh_t(std::vector<vertex_t> vertices, std::vector<GLuint> indices, vertex_format_t format = full_vertices, std::vector<lod_t> lods = {});
+    // takes vertices packed ahead of time together with their dequantise
+    mesh_t(std::vector<vertex_t> vertices, std::vector<GLuint> indices, vertex_format_t format, std::vector<lod_t> lods, const std::vector<packed_vertex_t> &packed, const glm::mat4 &dequantise);
     ~mesh_t();
+    // frees the cpu side copy of the geometry, the gpu copy stays
+    void release_geometry();
     material_t material;
+    bounds_t bounds;
     // do not fiddle with this
     std::vector<vertex_t> vertices;
     std::vector<GLuint> indices;
+    // kept apart from the vectors so they survive release_geometry
+    GLsizei vertex_count;
+    // every level together
+    GLsizei index_count;
+    std::vector<lod_t> lods;
+    vertex_format_t format;
+    // GL_UNSIGNED_SHORT when the mesh has its own buffers and fewer than 65536 vertices
+    GLenum index_type;
+    // takes packed positions back into model space, folded into the instance matrix
+    glm::mat4 dequantise = glm::mat4(1);
+    uint32_t key_id;
     GLuint vao;
     GLuint vbo;
     GLuint ebo;
+    // set when the mesh lives in the shared arenas, vbo and ebo are 0 then
+    geometry_t *geometry = NULL;
+    GLint base_vertex = 0;
+    GLuint first_index = 0;
+  private:
+    void assign(std::vector<vertex_t> &vertices, std::vector<GLuint> &indices, vertex_format_t format, std::vector<lod_t> &lods);
+    // hands the vertices in the layout of format and the indices to gl
+    void upload(const void *vertex_data);
   };
 
   class model_t
   {
   public:
-    model_t(std::string path);
+    // loads on the calling thread, see scppr::load_model for the asynchronous way
+    model_t(std::string path, vertex_format_t format = full_vertices);
     ~model_t();
+    // objects using the model are not drawn until it is ready
+    std::atomic<bool> ready{false};
+    // set when an asynchronous load gave up, the error has been logged
+    std::atomic<bool> failed{false};
+    // union of the mesh bounds
+    bounds_t bounds;
     // do not fiddle with this
     std::vector<mesh_t *> meshes;
     std::vector<material_t> materials;
+  private:
+    friend class scppr;
+    struct pending_t;
+    model_t();
+    // assimp import, mesh conversion, vertex packing and texture decoding, safe on any thread
+    // gives back what it staged when it fails
+    void import(std::string path);
+    void convert(std::string path);
+    // frees the images not uploaded yet and the rest of pending, safe on any thread
+    void drop_pending();
+    // everything the model holds, for the destructor and a failed constructor
+    void discard();
+    // creates one material or mesh of the import, returns true once the model is ready, gl thread only
+    // adds the bytes it handed to gl
+    bool upload_step(size_t &bytes);
+    pending_t *pending = NULL;
+    vertex_format_t format = full_vertices;
   };
 
   class object_t
@@ -84,13 +252,34 @@ namespace scppr
   public:
     object_t();
     ~object_t();
+    // transforms go through setters so only moved objects get their matrices rebuilt
+    void set_position(glm::dvec3 position);
+    void set_rotation(glm::dvec3 rotation);
+    void set_scale(glm::dvec3 scale);
+    glm::dvec3 get_position();
+    glm::dvec3 get_rotation();
+    glm::dvec3 get_scale();
+    // the model and is_static decide which tree the object is in, so they go through setters too
+    void set_model(model_t *model);
+    model_t *get_model();
+    // objects that rarely move live in a tree that is only rebuilt when static objects are added or removed
+    void set_static(bool is_static);
+    bool get_static();
+    bool hidden = false;
+    bool active = true;
+    std::map<int, material_t> material_overwrite;
+    // do not fiddle with this
+    registry_t *registry = NULL;
+    uint32_t handle = SCPPR_NO_HANDLE;
+    // level drawn last frame
+    uint32_t lod = 0;
+  private:
+    friend class scppr;
     glm::dvec3 position = {0, 0, 0};
     glm::dvec3 rotation = {0, 0, 0};
     glm::dvec3 scale = {1, 1, 1};
-    bool hidden = false;
-    bool active = true;
     model_t *model = NULL;
-    std::map<int, material_t> material_overwrite;
+    bool is_static = false;
   };
 
   class light_t
@@ -107,10 +296,67 @@ namespace scppr
     bool active = true;
   };
 
+  // the draw list is sorted by key, most expensive state change in the high bits
+  // program | diffuse | specular | mesh | lod | depth
+  // ids wrap past their field, 262144 meshes and 8192 textures, and only cost batching then
+  static const int SCPPR_KEY_PROGRAM_SHIFT = 60;
+  static const int SCPPR_KEY_DIFFUSE_SHIFT = 47;
+  static const int SCPPR_KEY_SPECULAR_SHIFT = 34;
+  static const int SCPPR_KEY_MESH_SHIFT = 16;
+  // two bits, enough for SCPPR_LOD_LEVELS
+  static const int SCPPR_KEY_LOD_SHIFT = 14;
+  static const int SCPPR_KEY_DEPTH_BITS = 14;
+
+  struct draw_item_t
+  {
+    uint64_t key;
+    mesh_t *mesh;
+    GLuint diffuse;
+    GLuint specular;
+    texture_t *diffuse_texture;
+    texture_t *specular_texture;
+    uint32_t instance;
+    uint32_t lod;
+  };
+
+  struct frame_stats_t
+  {
+    // visible objects that made it past frustum culling
+    uint32_t objects_submitted = 0;
+    // objects with a ready model that the frustum rejected, hidden ones included
+    uint32_t objects_culled = 0;
+    uint32_t draw_calls = 0;
+    uint32_t triangles = 0;
+    // gl state changes that reached the driver, see lib/gl/gl.h
+    uint32_t state_changes = 0;
+  };
+
+  // one instanced draw call, instances are a range of the frame's instance buffer
+  struct batch_t
+  {
+    mesh_t *mesh;
+    uint32_t lod;
+    GLuint diffuse;
+    GLuint specular;
+    uint32_t first_instance;
+    uint32_t instance_count;
+  };
+
+  // layout read by glMultiDrawElementsIndirect
+  struct draw_command_t
+  {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+  };
+
   class scppr
   {
   public:
-    scppr(std::string name, std::string assets_path);
+    // flags are SCPPR_MULTI_DRAW, SCPPR_TEXTURE_ARRAYS, SCPPR_RELEASE_GEOMETRY, SCPPR_OPTIMISE_MESHES, SCPPR_OPTIMISE_OVERDRAW and SCPPR_HEADLESS, missing extensions fall back to a draw per batch with a warning
+    scppr(std::string name, std::string assets_path, uint32_t flags = 0);
     ~scppr();
     void add_object(object_t *obj);
     void remove_object(object_t *obj);
@@ -123,8 +369,30 @@ namespace scppr
     void poll();
     void draw();
     void set_camera(double fov, glm::dvec3 eye, double pitch, double roll, double yaw, uint32_t flags);
+    // see SCPPR_LOD_SCREEN_SIZE and SCPPR_LOD_HYSTERESIS
+    void set_lod(double screen_size, double hysteresis);
     double get_width();
     double get_height();
+    // size of the offscreen framebuffer, only for headless instances, windows follow their framebuffer
+    void set_size(int width, int height);
+    // rgba of the last drawn frame, top row first, windows need SCPPR_KEEP_FRAMES
+    std::vector<unsigned char> read_pixels();
+    // hands every drawn frame to callback, read back without stalling and at most frames frames later
+    // works without SCPPR_KEEP_FRAMES, windows are read from their back buffer before the swap
+    // replaces a running capture, which is flushed first
+    // called from a capture callback, this and stop_capture take effect after the next frame is captured
+    void start_capture(capture_callback_t callback, capture_format_t format = capture_rgba, uint32_t frames = SCPPR_CAPTURE_DEPTH);
+    // waits for the frames still in flight and hands them over
+    void stop_capture();
+    // counters of the last drawn frame
+    frame_stats_t get_stats();
+    // returns at once, the model is imported on a loader thread and uploaded a slice per frame by draw
+    // watch ready or failed, and do not delete the model before one of them is set
+    // loads still queued when scppr is destroyed are failed
+    model_t *load_model(std::string path, vertex_format_t format = full_vertices);
+    // nearest object under the window coordinates, as reported by the mouse listener, as of the last drawn frame
+    // headless renderers take pixel coordinates of the offscreen framebuffer
+    object_t *pick(double x, double y);
     GLFWwindow *window;
   private:
     static void framebuffer_size_callback_wrap(GLFWwindow* window, int width, int height);
@@ -137,10 +405,80 @@ namespace scppr
     void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
     void click_callback(GLFWwindow* window, int button, int state, int mods);
     void keyboard_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    // cpu side of draw, runs on the job system and fills batches and instance_upload
+    void prepare_frame(const glm::dmat4 &vp);
+    void update_trees();
+    // inserts the object into the tree it belongs in and returns that, NULL while its model is not ready
+    bvh_t *place(uint32_t handle);
+    // runs upload steps of loaded models until the frame budget is spent
+    void process_uploads();
+    void draw_batches();
+    void draw_indirect();
+    // (re)creates the offscreen framebuffer at the current size
+    void create_framebuffer();
+    // returns false when the object was culled
+    bool collect_draw_items(uint32_t index, const frustum_t &frustum, const glm::dvec4 &depth_row, std::vector<draw_item_t> &items);
     int height = default_width;
     int width = default_height;
-    GLuint simple_light_program;
-    GLuint light_program;
+    bool headless = false;
+    // the offscreen framebuffer holds every drawn frame, always so when headless
+    bool keep_frames = false;
+    GLuint framebuffer = 0;
+    GLuint color_renderbuffer = 0;
+    GLuint depth_renderbuffer = 0;
+    capture_t *frame_capture = NULL;
+    struct capture_request_t
+    {
+      // empty to stop capturing
+      capture_callback_t callback;
+      capture_format_t format;
+      uint32_t frames;
+    };
+    // keeps a start or stop coming from a capture callback for draw, returns false when it can run at once
+    bool defer_capture(capture_request_t request);
+    // set while frame_capture may be running callbacks on the gl thread
+    bool capture_busy = false;
+    std::thread::id gl_thread;
+    std::mutex capture_request_mutex;
+    bool capture_requested = false;
+    capture_request_t capture_request;
+    program_t simple_light_program;
+    // simple_light built for packed vertices
+    program_t packed_light_program;
+    GLuint light_ubo;
+    light_block_t light_block;
+    GLuint instance_vbo;
+    std::vector<instance_t> instance_upload;
+    std::vector<draw_item_t> draw_items;
+    std::vector<std::vector<draw_item_t>> chunk_items;
+    std::vector<size_t> run_bounds;
+    std::vector<size_t> merged_bounds;
+    std::vector<batch_t> batches;
+    // one per vertex format, all set or none
+    geometry_t *geometry[vertex_format_count] = {NULL};
+    GLuint indirect_buffer = 0;
+    std::vector<draw_command_t> commands;
+    atlas_t *atlas = NULL;
+    GLenum texture_target = GL_TEXTURE_2D;
+    GLuint material_vbo = 0;
+    std::vector<material_instance_t> material_upload;
+    staging_ring_t *staging = NULL;
+    job_system_t jobs;
+    frame_stats_t stats;
+    bvh_t static_tree;
+    bvh_t dynamic_tree;
+    std::vector<uint32_t> placements;
+    // handles of objects outside the trees until their model is ready, by model
+    std::map<model_t *, std::vector<uint32_t>> waiting;
+    // loaded or failed since the last update_trees
+    std::vector<model_t *> finished_models;
+    std::vector<uint32_t> visible;
+    std::vector<std::pair<float, uint32_t>> hits;
+    glm::dmat4 last_vp = glm::dmat4(1);
+    double lod_screen_size = SCPPR_LOD_SCREEN_SIZE;
+    double lod_hysteresis = SCPPR_LOD_HYSTERESIS;
+    // turns a sphere radius over its clip w into a fraction of the viewport height
+    double lod_projection = 1;
     double camera_fov;
     glm::dvec3 camera_eye;
     glm::dvec3 camera_point;
@@ -150,11 +488,18 @@ namespace scppr
     glm::dvec3 camera_front;
     glm::dvec3 camera_right;
     glm::dvec3 camera_up;
-    std::set<object_t *> objects;
+    registry_t objects;
     std::set<light_t *> lights;
     std::map<listener_t, std::pair<void *, void *>> listeners;
     material_t default_material;
     light_t *default_ambient;
+    // models imported by the loaders, waiting for their gl objects
+    std::mutex upload_mutex;
+    std::deque<model_t *> uploads;
+    // kept apart from jobs so a frame never ends up helping with an import, shut down first thing in the destructor
+    job_system_t loaders{SCPPR_LOADER_THREADS};
+    // set by the destructor, imports still queued give up without touching the staging ring
+    std::atomic<bool> closing{false};
   };
 }
 
@@ -1,68 +1,98 @@
 #include "lib/shader/shader.h"
+#include "lib/scppr.h"
 #include "lib/log.h"
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
-GLuint load_shader(GLenum shader_type, std::string path)
+GLuint load_shader(GLenum shader_type, std::string path, const std::string &defines)
 {
   scppr_LOG("creating shader from [" + path + "]");
   GLuint shader = glCreateShader(shader_type);
-  scppr_LOG("reading shader code");
+  scppr_DEBUG("reading shader code");
   std::ifstream file(path);
   scppr_ASSERT(file.is_open(), "Failed to open file " + path);
   std::stringstream buffer;
   buffer << file.rdbuf();
   std::string shader_text = buffer.str();
+  if(!defines.empty())
+  {
+    size_t version_end = shader_text.find('\n') + 1;
+    shader_text.insert(version_end, defines);
+  }
   const char *shader_text_c_str = shader_text.c_str();
-  scppr_LOG("compiling shader");
+  scppr_DEBUG("compiling shader");
   glShaderSource(shader, 1, &shader_text_c_str, NULL);
   glCompileShader(shader);
   GLint result = GL_FALSE;
   int info_length;
-  scppr_LOG("checking shader correctness");
+  scppr_DEBUG("checking shader correctness");
   glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
   glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_length);
   if(info_length > 0)
   {
     char *s = new char[1024];
     glGetShaderInfoLog(shader, info_length, NULL, &s[0]);
-    scppr_LOG("encountered shader error - " + std::string(s));
+    scppr_ERROR("encountered shader error - " + std::string(s));
     delete[] s;
   }
   return shader;
 }
 
-GLuint load_program(std::string choice)
+static const char *uniform_names[uniform_count] =
+{
+  "v",
+  "p",
+  "material.diffuse",
+  "material.specular",
+  "material.shininess"
+};
+
+program_t load_program(std::string choice, std::string defines)
 {
   scppr_LOG("creating program");
+  program_t result_program;
   GLuint program = glCreateProgram();
   scppr_LOG("creating vertex shader");
-  GLuint v_shader = load_shader(GL_VERTEX_SHADER, scppr::_assets_path + "shader/" + choice + ".vertex_shader.c_");
+  GLuint v_shader = load_shader(GL_VERTEX_SHADER, scppr::_assets_path + "shader/" + choice + ".vertex_shader.c_", defines);
   scppr_LOG("creating fragment shader");
-  GLuint f_shader = load_shader(GL_FRAGMENT_SHADER, scppr::_assets_path + "shader/" + choice + ".fragment_shader.c_");
-  scppr_LOG("attaching shaders");
+  GLuint f_shader = load_shader(GL_FRAGMENT_SHADER, scppr::_assets_path + "shader/" + choice + ".fragment_shader.c_", defines);
+  scppr_DEBUG("attaching shaders");
   glAttachShader(program, v_shader);
   glAttachShader(program, f_shader);
-  scppr_LOG("linking program");
+  scppr_DEBUG("linking program");
   glLinkProgram(program);
   GLint result = GL_FALSE;
   int info_length;
-  scppr_LOG("checking program");
+  scppr_DEBUG("checking program");
   glGetProgramiv(program, GL_LINK_STATUS, &result);
   glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_length);
   if(info_length > 0)
   {
     char *s = new char[1024];
     glGetProgramInfoLog(program, info_length, NULL, &s[0]);
-    scppr_LOG("encountered linker error - " + std::string(s));
+    scppr_ERROR("encountered linker error - " + std::string(s));
     delete[] s;
   }
 
-  scppr_LOG("deleting shaders");
+  scppr_DEBUG("deleting shaders");
   glDetachShader(program, v_shader);
   glDetachShader(program, f_shader);
   glDeleteShader(v_shader);
   glDeleteShader(f_shader);
-  return program;
+
+  scppr_DEBUG("resolving uniform locations");
+  result_program.id = program;
+  for(int i = 0; i < uniform_count; i++)
+  {
+    result_program.uniforms[i] = glGetUniformLocation(program, uniform_names[i]);
+  }
+
+  scppr_DEBUG("binding uniform blocks");
+  GLuint light_block = glGetUniformBlockIndex(program, "light_block");
+  if(light_block != GL_INVALID_INDEX)
+  {
+    glUniformBlockBinding(program, light_block, SCPPR_LIGHT_BINDING);
+  }
+  return result_program;
 }
@@ -1,9 +1,77 @@
 #ifndef SCPPR_LIB_SHADER_SHADER_H
 #define SCPPR_LIB_SHADER_SHADER_H
 
-#include "scppr.h"
+#include "lib/glad.h"
+#include <glm/glm.hpp>
 #include <string>
 
-GLuint load_program(std::string choice);
+// must match MAX_LIGHTS in the fragment shaders
+static const int SCPPR_MAX_LIGHTS = 32;
+// uniform buffer binding points shared by every program
+static const GLuint SCPPR_LIGHT_BINDING = 0;
+// first vertex attribute of the per instance matrices, must match the vertex shaders
+static const GLuint SCPPR_INSTANCE_ATTRIBUTE = 3;
+static const GLuint SCPPR_INSTANCE_ATTRIBUTE_COUNT = 7;
+// per instance texture placement, only read by programs built with SCPPR_TEXTURE_ARRAYS
+static const GLuint SCPPR_MATERIAL_ATTRIBUTE = 10;
+static const GLuint SCPPR_MATERIAL_ATTRIBUTE_COUNT = 3;
+
+enum uniform_t
+{
+  uniform_v,
+  uniform_p,
+  uniform_material_diffuse,
+  uniform_material_specular,
+  uniform_material_shininess,
+  uniform_count
+};
+
+// uniform locations are resolved once when the program is linked
+// uniforms the program does not use are set to -1, which gl ignores
+class program_t
+{
+public:
+  GLuint id = 0;
+  GLint uniforms[uniform_count];
+};
+
+// per instance vertex attributes, model matrix followed by its normal matrix
+struct instance_t
+{
+  glm::mat4 model;
+  glm::mat3 normal;
+};
+
+// per instance vertex attributes of the texture array path, where in its array each texture sits
+struct material_instance_t
+{
+  glm::vec4 diffuse_rect;
+  glm::vec4 specular_rect;
+  glm::vec2 layers;
+};
+
+// std140 mirror of light_t in the fragment shaders
+struct light_entry_t
+{
+  glm::vec3 position;
+  float _pad0;
+  glm::vec3 ambient;
+  float _pad1;
+  glm::vec3 diffuse;
+  float _pad2;
+  glm::vec3 specular;
+  float strength;
+};
+
+// std140 mirror of the light_block uniform block
+struct light_block_t
+{
+  light_entry_t lights[SCPPR_MAX_LIGHTS];
+  GLint light_no;
+  GLint _pad[3];
+};
+
+// defines are placed right after the #version line of both shaders
+program_t load_program(std::string choice, std::string defines = "");
 
 #endif // SCPPR_LIB_SHADER_SHADER_H
@@ -0,0 +1,142 @@
+#include "lib/staging/staging.h"
+#include "lib/gl/gl.h"
+#include "lib/log.h"
+#include <string>
+
+namespace
+{
+  // keeps every range usable as an unpack offset for any format
+  const size_t alignment = 64;
+}
+
+scppr::staging_ring_t::staging_ring_t(size_t capacity)
+{
+  this -> capacity = capacity;
+  if(!GLAD_GL_ARB_buffer_storage)
+  {
+    scppr_WARN("buffer storage is not supported, textures are uploaded without staging");
+    return;
+  }
+  scppr_DEBUG("creating staging ring of " + std::to_string(capacity) + " bytes");
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &buffer);
+  gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+  glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, NULL, flags);
+  mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags);
+  gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  persistent = mapped != NULL;
+}
+
+scppr::staging_ring_t::~staging_ring_t()
+{
+  for(auto &region : regions)
+  {
+    if(region.fence)
+    {
+      glDeleteSync(region.fence);
+    }
+  }
+  if(buffer)
+  {
+    gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl_delete_buffer(buffer);
+  }
+}
+
+unsigned char *scppr::staging_ring_t::reserve(size_t size, size_t &offset)
+{
+  size = (size + alignment - 1) / alignment * alignment;
+  std::lock_guard<std::mutex> lock(mutex);
+  if(!persistent || size > capacity)
+  {
+    return NULL;
+  }
+  if(regions.empty())
+  {
+    head = 0;
+  }
+  size_t tail = regions.empty() ? 0 : regions.front().offset;
+  // the write position has wrapped around behind the oldest range in use
+  bool wrapped = !regions.empty() && head <= tail;
+  if(wrapped)
+  {
+    if(head + size > tail)
+    {
+      return NULL;
+    }
+  }
+  else if(head + size > capacity)
+  {
+    if(size > tail)
+    {
+      return NULL;
+    }
+    // the end of the buffer is skipped, it frees up together with the range before it
+    region_t skipped;
+    skipped.offset = head;
+    skipped.size = capacity - head;
+    skipped.retired = true;
+    regions.push_back(skipped);
+    head = 0;
+  }
+  region_t region;
+  region.offset = head;
+  region.size = size;
+  regions.push_back(region);
+  offset = head;
+  head += size;
+  return mapped + offset;
+}
+
+void scppr::staging_ring_t::retire(size_t offset)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto &region : regions)
+  {
+    if(region.offset == offset && !region.retired)
+    {
+      region.retired = true;
+      region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      return;
+    }
+  }
+}
+
+const unsigned char *scppr::staging_ring_t::data(size_t offset) const
+{
+  return mapped + offset;
+}
+
+void scppr::staging_ring_t::release(size_t offset)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  for(auto &region : regions)
+  {
+    if(region.offset == offset && !region.retired)
+    {
+      region.retired = true;
+      return;
+    }
+  }
+}
+
+void scppr::staging_ring_t::collect()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  while(!regions.empty() && regions.front().retired)
+  {
+    region_t &region = regions.front();
+    if(region.fence)
+    {
+      GLenum state = glClientWaitSync(region.fence, 0, 0);
+      if(state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+      {
+        return;
+      }
+      glDeleteSync(region.fence);
+    }
+    regions.pop_front();
+  }
+}
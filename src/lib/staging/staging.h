@@ -0,0 +1,48 @@
+#ifndef SCPPR_LIB_STAGING_STAGING_H
+#define SCPPR_LIB_STAGING_STAGING_H
+
+#include "lib/glad.h"
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace scppr
+{
+  // persistently mapped pixel unpack buffer used as a ring
+  // any thread reserves a range and writes pixels into it, the gl thread uploads from it and retires the range
+  // retired ranges come back once the fence placed behind their upload has signalled
+  // needs ARB_buffer_storage, check persistent before use
+  class staging_ring_t
+  {
+  public:
+    staging_ring_t(size_t capacity);
+    ~staging_ring_t();
+    // pointer to write size bytes to, NULL when the ring has no room right now
+    unsigned char *reserve(size_t size, size_t &offset);
+    // gl thread, after the commands reading the range were issued
+    void retire(size_t offset);
+    // hands back a range no gl command read, comes back without a fence, safe on any thread
+    void release(size_t offset);
+    // gl thread, hands back retired ranges the gpu is done with
+    void collect();
+    // what was written to a range still reserved
+    const unsigned char *data(size_t offset) const;
+    GLuint buffer = 0;
+    bool persistent = false;
+  private:
+    struct region_t
+    {
+      size_t offset;
+      size_t size;
+      bool retired = false;
+      GLsync fence = 0;
+    };
+    size_t capacity;
+    size_t head = 0;
+    unsigned char *mapped = NULL;
+    std::deque<region_t> regions;
+    std::mutex mutex;
+  };
+}
+
+#endif // SCPPR_LIB_STAGING_STAGING_H
@@ -0,0 +1,215 @@
+#include "lib/transform/transform.h"
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCPPR_TRANSFORM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCPPR_TRANSFORM_SSE2
+#endif
+
+namespace
+{
+  const double two_pi = 6.283185307179586;
+
+  // wraps to [-pi, pi] in double precision so the float sincos stays accurate for large angles
+  inline float wrap_angle(double angle)
+  {
+    return (float)(angle - two_pi * std::nearbyint(angle / two_pi));
+  }
+
+  // r is the column major rotation, k the scale and p the translation
+  inline void store_transform(instance_t &transform, const float *r, const float *k, const float *p)
+  {
+    float *model = &transform.model[0][0];
+    float *normal = &transform.normal[0][0];
+    for(int col = 0; col < 3; col++)
+    {
+      float inverse_k = 1.0f / k[col];
+      for(int row = 0; row < 3; row++)
+      {
+        model[col * 4 + row] = r[col * 3 + row] * k[col];
+        normal[col * 3 + row] = r[col * 3 + row] * inverse_k;
+      }
+      model[col * 4 + 3] = 0;
+    }
+    model[12] = p[0];
+    model[13] = p[1];
+    model[14] = p[2];
+    model[15] = 1;
+  }
+
+  // rotate_x * rotate_y * rotate_z in column major order, the vector kernel spells out the same products
+  inline void rotation(float c0, float s0, float c1, float s1, float c2, float s2, float *r)
+  {
+    r[0] = c1 * c2;
+    r[1] = c0 * s2 + s0 * s1 * c2;
+    r[2] = s0 * s2 - c0 * s1 * c2;
+    r[3] = -(c1 * s2);
+    r[4] = c0 * c2 - s0 * s1 * s2;
+    r[5] = s0 * c2 + c0 * s1 * s2;
+    r[6] = s1;
+    r[7] = -(s0 * c1);
+    r[8] = c0 * c1;
+  }
+
+#if defined(SCPPR_TRANSFORM_AVX2) || defined(SCPPR_TRANSFORM_SSE2)
+  // thin wrappers so one kernel body serves both vector widths
+#if defined(SCPPR_TRANSFORM_AVX2)
+  const int width = 8;
+  typedef __m256 vf;
+  typedef __m256i vi;
+  inline vf load(const float *p) { return _mm256_load_ps(p); }
+  inline void store(float *p, vf a) { _mm256_store_ps(p, a); }
+  inline vf set1(float a) { return _mm256_set1_ps(a); }
+  inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+  inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+  inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+  inline vf bit_xor(vf a, vf b) { return _mm256_xor_ps(a, b); }
+  inline vf select(vf mask, vf a, vf b) { return _mm256_blendv_ps(b, a, mask); }
+  inline vi round_to_int(vf a) { return _mm256_cvtps_epi32(a); }
+  inline vf to_float(vi a) { return _mm256_cvtepi32_ps(a); }
+  inline vi int_and(vi a, int b) { return _mm256_and_si256(a, _mm256_set1_epi32(b)); }
+  inline vi int_add(vi a, int b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+  inline vf nonzero_mask(vi a) { return _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(a, _mm256_setzero_si256()), _mm256_set1_epi32(-1))); }
+  inline vf bit_two_as_sign(vi a) { return _mm256_castsi256_ps(_mm256_slli_epi32(int_and(a, 2), 30)); }
+#else
+  const int width = 4;
+  typedef __m128 vf;
+  typedef __m128i vi;
+  inline vf load(const float *p) { return _mm_load_ps(p); }
+  inline void store(float *p, vf a) { _mm_store_ps(p, a); }
+  inline vf set1(float a) { return _mm_set1_ps(a); }
+  inline vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+  inline vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+  inline vf mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+  inline vf bit_xor(vf a, vf b) { return _mm_xor_ps(a, b); }
+  inline vf select(vf mask, vf a, vf b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+  inline vi round_to_int(vf a) { return _mm_cvtps_epi32(a); }
+  inline vf to_float(vi a) { return _mm_cvtepi32_ps(a); }
+  inline vi int_and(vi a, int b) { return _mm_and_si128(a, _mm_set1_epi32(b)); }
+  inline vi int_add(vi a, int b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+  inline vf nonzero_mask(vi a) { return _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), _mm_set1_epi32(-1))); }
+  inline vf bit_two_as_sign(vi a) { return _mm_castsi128_ps(_mm_slli_epi32(int_and(a, 2), 30)); }
+#endif
+
+  // sine and cosine of x in [-pi, pi], cephes minimax polynomials on [-pi / 4, pi / 4]
+  inline void sincos(vf x, vf &s, vf &c)
+  {
+    vi quadrant = round_to_int(mul(x, set1(0.63661977236f)));
+    vf q = to_float(quadrant);
+    // pi / 2 split in three so the reduction stays exact
+    x = sub(x, mul(q, set1(1.5703125f)));
+    x = sub(x, mul(q, set1(4.837512969970703125e-4f)));
+    x = sub(x, mul(q, set1(7.54978995489188216e-8f)));
+    vf z = mul(x, x);
+
+    vf ps = set1(-1.9515295891e-4f);
+    ps = add(mul(ps, z), set1(8.3321608736e-3f));
+    ps = add(mul(ps, z), set1(-1.6666654611e-1f));
+    ps = add(mul(mul(ps, z), x), x);
+
+    vf pc = set1(2.443315711809948e-5f);
+    pc = add(mul(pc, z), set1(-1.388731625493765e-3f));
+    pc = add(mul(pc, z), set1(4.166664568298827e-2f));
+    pc = add(sub(mul(mul(pc, z), z), mul(z, set1(0.5f))), set1(1.0f));
+
+    // odd quadrants swap sine and cosine, quadrants 2 and 3 flip the sine, 1 and 2 flip the cosine
+    vf swap = nonzero_mask(int_and(quadrant, 1));
+    s = bit_xor(select(swap, pc, ps), bit_two_as_sign(quadrant));
+    c = bit_xor(select(swap, ps, pc), bit_two_as_sign(int_add(quadrant, 1)));
+  }
+
+  void compute_transforms_vector(const uint32_t *indices, size_t count, const glm::dvec3 *positions, const glm::dvec3 *rotations, const glm::dvec3 *scales, instance_t *transforms)
+  {
+    alignas(32) float in[9][width];
+    alignas(32) float out[9][width];
+    for(size_t base = 0; base + width <= count; base += width)
+    {
+      for(int lane = 0; lane < width; lane++)
+      {
+        uint32_t i = indices[base + lane];
+        for(int axis = 0; axis < 3; axis++)
+        {
+          in[axis][lane] = wrap_angle(rotations[i][axis]);
+          in[3 + axis][lane] = scales[i][axis];
+          in[6 + axis][lane] = positions[i][axis];
+        }
+      }
+
+      vf s0, c0, s1, c1, s2, c2;
+      sincos(load(in[0]), s0, c0);
+      sincos(load(in[1]), s1, c1);
+      sincos(load(in[2]), s2, c2);
+      vf r[9];
+      r[0] = mul(c1, c2);
+      r[1] = add(mul(c0, s2), mul(mul(s0, s1), c2));
+      r[2] = sub(mul(s0, s2), mul(mul(c0, s1), c2));
+      r[3] = sub(set1(0), mul(c1, s2));
+      r[4] = sub(mul(c0, c2), mul(mul(s0, s1), s2));
+      r[5] = add(mul(s0, c2), mul(mul(c0, s1), s2));
+      r[6] = s1;
+      r[7] = sub(set1(0), mul(s0, c1));
+      r[8] = mul(c0, c1);
+      for(int j = 0; j < 9; j++)
+      {
+        store(out[j], r[j]);
+      }
+
+      for(int lane = 0; lane < width; lane++)
+      {
+        float rl[9], kl[3], pl[3];
+        for(int j = 0; j < 9; j++)
+        {
+          rl[j] = out[j][lane];
+        }
+        for(int j = 0; j < 3; j++)
+        {
+          kl[j] = in[3 + j][lane];
+          pl[j] = in[6 + j][lane];
+        }
+        store_transform(transforms[indices[base + lane]], rl, kl, pl);
+      }
+    }
+    size_t done = count - count % width;
+    scppr::compute_transforms_scalar(indices + done, count - done, positions, rotations, scales, transforms);
+  }
+#endif
+}
+
+void scppr::compute_transforms(const uint32_t *indices, size_t count, const glm::dvec3 *positions, const glm::dvec3 *rotations, const glm::dvec3 *scales, instance_t *transforms)
+{
+#if defined(SCPPR_TRANSFORM_AVX2) || defined(SCPPR_TRANSFORM_SSE2)
+  compute_transforms_vector(indices, count, positions, rotations, scales, transforms);
+#else
+  compute_transforms_scalar(indices, count, positions, rotations, scales, transforms);
+#endif
+}
+
+void scppr::compute_transforms_scalar(const uint32_t *indices, size_t count, const glm::dvec3 *positions, const glm::dvec3 *rotations, const glm::dvec3 *scales, instance_t *transforms)
+{
+  for(size_t n = 0; n < count; n++)
+  {
+    uint32_t i = indices[n];
+    float a0 = wrap_angle(rotations[i].x);
+    float a1 = wrap_angle(rotations[i].y);
+    float a2 = wrap_angle(rotations[i].z);
+    float r[9];
+    rotation(std::cos(a0), std::sin(a0), std::cos(a1), std::sin(a1), std::cos(a2), std::sin(a2), r);
+    float k[3] = {(float)scales[i].x, (float)scales[i].y, (float)scales[i].z};
+    float p[3] = {(float)positions[i].x, (float)positions[i].y, (float)positions[i].z};
+    store_transform(transforms[i], r, k, p);
+  }
+}
+
+const char *scppr::transform_kernel()
+{
+#if defined(SCPPR_TRANSFORM_AVX2)
+  return "avx2";
+#elif defined(SCPPR_TRANSFORM_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
@@ -0,0 +1,22 @@
+#ifndef SCPPR_LIB_TRANSFORM_TRANSFORM_H
+#define SCPPR_LIB_TRANSFORM_TRANSFORM_H
+
+#include "lib/shader/shader.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace scppr
+{
+  // builds the instance transforms of the objects listed in indices
+  // model is translate(position) * rotate_x * rotate_y * rotate_z * scale(scale), the glm chain draw used to run
+  // normal is transpose(inverse(mat3(model))), which reduces to rotation / scale
+  // dispatches to the widest kernel the library was compiled for
+  void compute_transforms(const uint32_t *indices, size_t count, const glm::dvec3 *positions, const glm::dvec3 *rotations, const glm::dvec3 *scales, instance_t *transforms);
+  // portable fallback, also used for the tail of the vector kernels
+  void compute_transforms_scalar(const uint32_t *indices, size_t count, const glm::dvec3 *positions, const glm::dvec3 *rotations, const glm::dvec3 *scales, instance_t *transforms);
+  // "avx2", "sse2" or "scalar"
+  const char *transform_kernel();
+}
+
+#endif // SCPPR_LIB_TRANSFORM_TRANSFORM_H
@@ -0,0 +1,292 @@
+#include "lib/vertex_cache/vertex_cache.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  // scoring constants from forsyth's article, the scoring cache is larger than the one assumed for acmr on purpose
+  const int scoring_cache_size = 32;
+  const float cache_decay_power = 1.5f;
+  const float last_triangle_score = 0.75f;
+  const float valence_boost_scale = 2.0f;
+  const float valence_boost_power = 0.5f;
+  // clusters smaller than this are merged into the one before, tiny clusters cost acmr and sort no better
+  const size_t min_cluster_triangles = 32;
+
+  float vertex_score(int cache_position, uint32_t remaining)
+  {
+    if(!remaining)
+    {
+      return -1;
+    }
+    float score = 0;
+    if(cache_position >= 0)
+    {
+      // the three vertices of the last triangle score the same, whatever order they went in
+      if(cache_position < 3)
+      {
+        score = last_triangle_score;
+      }
+      else
+      {
+        score = std::pow(1 - (float)(cache_position - 3) / (scoring_cache_size - 3), cache_decay_power);
+      }
+    }
+    // vertices with few triangles left are finished off first so they can leave the cache
+    return score + valence_boost_scale * std::pow((float)remaining, -valence_boost_power);
+  }
+
+  glm::dvec3 position_of(const float *positions, size_t stride, uint32_t vertex)
+  {
+    const float *p = (const float *)((const char *)positions + vertex * stride);
+    return glm::dvec3(p[0], p[1], p[2]);
+  }
+}
+
+float scppr::acmr(const std::vector<uint32_t> &indices, size_t vertex_count, uint32_t cache_size)
+{
+  if(indices.size() < 3)
+  {
+    return 0;
+  }
+  // a vertex is cached while fewer than cache_size misses happened since it was loaded
+  std::vector<uint32_t> loaded(vertex_count, 0);
+  uint32_t misses = 0;
+  for(auto vertex : indices)
+  {
+    if(!loaded[vertex] || misses - loaded[vertex] >= cache_size)
+    {
+      misses++;
+      loaded[vertex] = misses;
+    }
+  }
+  return (float)misses / (indices.size() / 3);
+}
+
+void scppr::optimise_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count)
+{
+  size_t triangle_count = indices.size() / 3;
+  if(triangle_count < 2)
+  {
+    return;
+  }
+
+  // triangles around every vertex
+  std::vector<uint32_t> remaining(vertex_count, 0);
+  for(size_t i = 0; i < triangle_count * 3; i++)
+  {
+    remaining[indices[i]]++;
+  }
+  std::vector<uint32_t> first_triangle(vertex_count + 1, 0);
+  for(size_t vertex = 0; vertex < vertex_count; vertex++)
+  {
+    first_triangle[vertex + 1] = first_triangle[vertex] + remaining[vertex];
+  }
+  std::vector<uint32_t> triangles(triangle_count * 3);
+  std::vector<uint32_t> fill(first_triangle.begin(), first_triangle.end() - 1);
+  for(size_t i = 0; i < triangle_count * 3; i++)
+  {
+    triangles[fill[indices[i]]++] = i / 3;
+  }
+
+  std::vector<int> cache_position(vertex_count, -1);
+  std::vector<float> score(vertex_count);
+  for(size_t vertex = 0; vertex < vertex_count; vertex++)
+  {
+    score[vertex] = vertex_score(-1, remaining[vertex]);
+  }
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> next_cache;
+  std::vector<uint32_t> result;
+  result.reserve(triangle_count * 3);
+  // next triangle in input order, taken whenever the cache offers nothing
+  size_t cursor = 0;
+  int64_t best = 0;
+  while(result.size() < triangle_count * 3)
+  {
+    if(best < 0)
+    {
+      while(emitted[cursor])
+      {
+        cursor++;
+      }
+      best = cursor;
+    }
+    emitted[best] = true;
+    const uint32_t *triangle = &indices[best * 3];
+    result.insert(result.end(), triangle, triangle + 3);
+
+    // the triangle's vertices move to the front, everything else shifts back
+    next_cache.assign(triangle, triangle + 3);
+    for(auto vertex : cache)
+    {
+      if(vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+      {
+        next_cache.push_back(vertex);
+      }
+    }
+    for(int corner = 0; corner < 3; corner++)
+    {
+      remaining[triangle[corner]]--;
+    }
+    for(size_t i = scoring_cache_size; i < next_cache.size(); i++)
+    {
+      cache_position[next_cache[i]] = -1;
+      score[next_cache[i]] = vertex_score(-1, remaining[next_cache[i]]);
+    }
+    next_cache.resize(std::min<size_t>(next_cache.size(), scoring_cache_size));
+    for(size_t i = 0; i < next_cache.size(); i++)
+    {
+      cache_position[next_cache[i]] = i;
+      score[next_cache[i]] = vertex_score(i, remaining[next_cache[i]]);
+    }
+    cache.swap(next_cache);
+
+    // only triangles touching the cache can be good choices
+    best = -1;
+    float best_score = -std::numeric_limits<float>::infinity();
+    for(auto vertex : cache)
+    {
+      for(uint32_t t = first_triangle[vertex]; t < first_triangle[vertex + 1]; t++)
+      {
+        uint32_t candidate = triangles[t];
+        if(emitted[candidate])
+        {
+          continue;
+        }
+        const uint32_t *corners = &indices[candidate * 3];
+        float candidate_score = score[corners[0]] + score[corners[1]] + score[corners[2]];
+        if(candidate_score > best_score)
+        {
+          best_score = candidate_score;
+          best = candidate;
+        }
+      }
+    }
+  }
+  indices.swap(result);
+}
+
+void scppr::optimise_overdraw(std::vector<uint32_t> &indices, const float *positions, size_t vertex_count, size_t stride)
+{
+  size_t triangle_count = indices.size() / 3;
+  if(triangle_count < 2 * min_cluster_triangles)
+  {
+    return;
+  }
+
+  // a triangle missing the cache with two or more vertices nearly starts over, cutting there costs little acmr
+  std::vector<size_t> starts(1, 0);
+  std::vector<uint32_t> loaded(vertex_count, 0);
+  uint32_t misses = 0;
+  for(size_t t = 0; t < triangle_count; t++)
+  {
+    int triangle_misses = 0;
+    for(int corner = 0; corner < 3; corner++)
+    {
+      uint32_t vertex = indices[t * 3 + corner];
+      if(!loaded[vertex] || misses - loaded[vertex] >= SCPPR_VERTEX_CACHE_SIZE)
+      {
+        misses++;
+        loaded[vertex] = misses;
+        triangle_misses++;
+      }
+    }
+    if(triangle_misses >= 2 && t - starts.back() >= min_cluster_triangles)
+    {
+      starts.push_back(t);
+    }
+  }
+  starts.push_back(triangle_count);
+  size_t cluster_count = starts.size() - 1;
+  if(cluster_count < 2)
+  {
+    return;
+  }
+
+  // clusters facing away from the middle of the mesh tend to be in front of the rest
+  std::vector<glm::dvec3> centers(cluster_count);
+  std::vector<glm::dvec3> normals(cluster_count);
+  std::vector<double> areas(cluster_count, 0);
+  glm::dvec3 mesh_center(0, 0, 0);
+  double mesh_area = 0;
+  for(size_t cluster = 0; cluster < cluster_count; cluster++)
+  {
+    glm::dvec3 center(0, 0, 0);
+    glm::dvec3 normal(0, 0, 0);
+    for(size_t t = starts[cluster]; t < starts[cluster + 1]; t++)
+    {
+      glm::dvec3 a = position_of(positions, stride, indices[t * 3]);
+      glm::dvec3 b = position_of(positions, stride, indices[t * 3 + 1]);
+      glm::dvec3 c = position_of(positions, stride, indices[t * 3 + 2]);
+      glm::dvec3 cross = glm::cross(b - a, c - a);
+      double area = glm::length(cross);
+      glm::dvec3 centroid = (a + b + c) / 3.0;
+      center = center + centroid * area;
+      normal = normal + cross;
+      areas[cluster] += area;
+    }
+    mesh_center = mesh_center + center;
+    mesh_area += areas[cluster];
+    centers[cluster] = areas[cluster] > 0 ? center / areas[cluster] : center;
+    normals[cluster] = normal;
+  }
+  if(mesh_area > 0)
+  {
+    mesh_center = mesh_center / mesh_area;
+  }
+  std::vector<double> outwardness(cluster_count, 0);
+  for(size_t cluster = 0; cluster < cluster_count; cluster++)
+  {
+    double length = glm::length(normals[cluster]);
+    if(length > 0)
+    {
+      outwardness[cluster] = glm::dot(centers[cluster] - mesh_center, normals[cluster] / length);
+    }
+  }
+
+  std::vector<size_t> order(cluster_count);
+  for(size_t cluster = 0; cluster < cluster_count; cluster++)
+  {
+    order[cluster] = cluster;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+  {
+    return outwardness[a] > outwardness[b];
+  });
+  std::vector<uint32_t> result;
+  result.reserve(triangle_count * 3);
+  for(auto cluster : order)
+  {
+    result.insert(result.end(), indices.begin() + starts[cluster] * 3, indices.begin() + starts[cluster + 1] * 3);
+  }
+  indices.swap(result);
+}
+
+std::vector<uint32_t> scppr::optimise_vertex_fetch(std::vector<uint32_t> &indices, size_t vertex_count)
+{
+  const uint32_t unused = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> renumbered(vertex_count, unused);
+  std::vector<uint32_t> order;
+  order.reserve(vertex_count);
+  for(auto &vertex : indices)
+  {
+    if(renumbered[vertex] == unused)
+    {
+      renumbered[vertex] = order.size();
+      order.push_back(vertex);
+    }
+    vertex = renumbered[vertex];
+  }
+  for(uint32_t vertex = 0; vertex < vertex_count; vertex++)
+  {
+    if(renumbered[vertex] == unused)
+    {
+      order.push_back(vertex);
+    }
+  }
+  return order;
+}
@@ -0,0 +1,25 @@
+#ifndef SCPPR_LIB_VERTEX_CACHE_VERTEX_CACHE_H
+#define SCPPR_LIB_VERTEX_CACHE_VERTEX_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace scppr
+{
+  // post transform cache assumed by the triangle ordering and by acmr
+  static const uint32_t SCPPR_VERTEX_CACHE_SIZE = 16;
+
+  // average cache misses per triangle of a fifo cache, 3 is the worst, about 0.5 the best a closed mesh gets to
+  float acmr(const std::vector<uint32_t> &indices, size_t vertex_count, uint32_t cache_size = SCPPR_VERTEX_CACHE_SIZE);
+  // reorders triangles so vertices are reused while still in the cache, after tom forsyth's linear speed optimisation
+  void optimise_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count);
+  // splits a cache ordered triangle list where the cache restarts and draws outward facing clusters first
+  // positions are three floats every stride bytes, costs little acmr as the clusters keep their order inside
+  void optimise_overdraw(std::vector<uint32_t> &indices, const float *positions, size_t vertex_count, size_t stride);
+  // renumbers vertices in the order the indices first use them, unused ones last
+  // returns for every new vertex the old one, the caller moves the vertices accordingly
+  std::vector<uint32_t> optimise_vertex_fetch(std::vector<uint32_t> &indices, size_t vertex_count);
+}
+
+#endif // SCPPR_LIB_VERTEX_CACHE_VERTEX_CACHE_H